@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+#define ARENA_ALIGNMENT 64
+
+// A single block of memory that is carved up front to back, every allocation starts on its own cache line.
+// An arena without memory only measures, which lets a layout be sized before anything is allocated.
+typedef struct {
+	byte* memory;
+	size_t capacity;
+	size_t used;
+
+	bool huge_pages;
+	bool mapped;
+} Arena;
+
+Arena* Arena_create(size_t capacity);
+void Arena_destroy(Arena* arena);
+
+void* Arena_push(Arena* arena, size_t size);
+void Arena_reset(Arena* arena);
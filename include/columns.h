@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "arena.h"
+
+#define COLUMN_MAX 32
+#define COLUMN_WORD_BITS 32
+
+enum {
+	// The column holds agent state, so it follows the agents whenever they are reordered
+	COLUMN_PERMUTED = 1,
+	// One bit per agent packed into words, the element size is ignored
+	COLUMN_BITS = 2
+};
+
+typedef struct {
+	const char* name;
+	void** data;
+	size_t element_size;
+	byte flags;
+} Column;
+
+// Named per agent arrays carved out of one arena, each on its own cache line. Every column is handed out through the
+// pointer it was added with, so kernels keep indexing plain arrays and never pay for the columns they don't read.
+// Clearing works on word ranges for bit columns, so ranges split between workers have to start on a multiple of
+// COLUMN_WORD_BITS
+typedef struct {
+	Column columns[COLUMN_MAX];
+	uint count;
+} Columns;
+
+bool Columns_add(Columns* columns, const char* name, void** data, size_t element_size, byte flags);
+
+void Columns_measure(Columns* columns, Arena* arena, uint count);
+void Columns_layout(Columns* columns, Arena* arena, uint count);
+void Columns_clear(Columns* columns, uint begin, uint end);
+void Columns_permute(Columns* columns, uint* order, uint count, byte* scratch);
+
+// Bytes a column takes per agent, an eighth for a bit column
+static inline float Column_agent_bytes(Column* column) {
+	return column->flags & COLUMN_BITS ? 1 / 8.f : (float) column->element_size;
+}
+
+static inline size_t Columns_bit_words(uint count) {
+	return (count + COLUMN_WORD_BITS - 1) / COLUMN_WORD_BITS;
+}
+
+static inline bool Columns_bit(const uint* bits, uint i) {
+	return (bits[i / COLUMN_WORD_BITS] >> (i % COLUMN_WORD_BITS)) & 1;
+}
+
+static inline void Columns_set_bit(uint* bits, uint i, bool value) {
+	uint mask = 1u << (i % COLUMN_WORD_BITS);
+	bits[i / COLUMN_WORD_BITS] = value ? bits[i / COLUMN_WORD_BITS] | mask : bits[i / COLUMN_WORD_BITS] & ~mask;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdbool.h>
+
+#include "types.h"
+
+// Radix 2 complex FFT of a fixed power of two size. Twiddles and the bit reversal are worked out once, transforms
+// then run in place on separate real and imaginary arrays.
+typedef struct {
+	uint size;
+	uint* reversed;
+	float* cosines;
+	float* sines;
+} Fft;
+
+Fft* Fft_create(uint size);
+void Fft_destroy(Fft* fft);
+
+// Transform the size values real[i * stride], imag[i * stride]. The inverse is not scaled by 1 / size
+void Fft_run(Fft* fft, float* real, float* imag, uint stride, bool inverse);
@@ -0,0 +1,32 @@
+#pragma once
+#include <raylib.h>
+
+#include "types.h"
+
+// A grid of directions covering the world, each cell pointing along the shortest route towards a single target.
+// Building is expensive, sampling is a single lookup, so fields should only be rebuilt when the target moves.
+typedef struct {
+	Vector2* directions;
+	float* costs;
+
+	ushort columns;
+	ushort rows;
+	float cell_size;
+
+	Vector2 target;
+} FlowField;
+
+FlowField* FlowField_create(float world_width, float world_height, float cell_size);
+void FlowField_destroy(FlowField* field);
+
+void FlowField_build(FlowField* field, Vector2 target, Rectangle* obstacles, ushort obstacle_count);
+
+static inline Vector2 FlowField_sample(FlowField* field, Vector2 position) {
+	int column = (int) (position.x / field->cell_size);
+	int row = (int) (position.y / field->cell_size);
+
+	column = column < 0 ? 0 : (column >= field->columns ? field->columns - 1 : column);
+	row = row < 0 ? 0 : (row >= field->rows ? field->rows - 1 : row);
+
+	return field->directions[row * field->columns + column];
+}
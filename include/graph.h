@@ -14,6 +14,7 @@ typedef struct {
 
 Graph* Graph_create(uint max_points);
 void Graph_destroy(Graph* graph);
+void Graph_clear(Graph* graph);
 
 float Graph_get_highest_value(Graph* graph);
 
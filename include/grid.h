@@ -0,0 +1,105 @@
+#pragma once
+#include <raylib.h>
+
+#include "types.h"
+#include "workers.h"
+#include "tiles.h"
+
+// Marks the unused slack slots of the incremental grid
+#define GRID_EMPTY 0xffffffffu
+
+// Uniform grid over the world. Agents are ordered by cell, cell c holds cell_counts[c] agents starting at
+// cell_starts[c], and cell_starts[c + 1] is where the next cell's space begins. A full build is a counting sort that
+// leaves no gaps. The incremental grid leaves slack behind every cell instead, so an agent that crosses into another
+// cell can be moved on its own, and only lays everything out again when a cell overflows or too many have moved.
+// A world too large to give every cell its own space is folded, cell (c, r) of the world lands in grid cell
+// (c mod columns, r mod rows). Agents far apart can then share a cell, which searches already skip by distance
+typedef struct {
+	uint* cell_starts;
+	uint* cell_counts;
+	uint* cells;
+	uint* next_cells;
+	uint* agents;
+	uint* slots;
+
+	uint columns;
+	uint rows;
+	uint cell_count;
+	float cell_size;
+
+	uint world_columns;
+	uint world_rows;
+	bool folded;
+
+	uint capacity;
+	uint count;
+	uint slot_count;
+	uint slot_capacity;
+
+	// Agents moved since the last full layout, agents that changed cell in the last update, and how many layouts
+	// there have been
+	bool incremental;
+	uint moved;
+	uint crossed;
+	uint layouts;
+
+	// Agents that changed cell in each binning chunk of the last update
+	uint* chunk_crossed;
+
+	// Cells split into ranges of about equal work, and the slots each range starts at in the current build
+	uint* partition;
+	uint* partition_slots;
+	uint partition_count;
+} Grid;
+
+// The block of cells around a position that holds every agent within one cell size of it
+typedef struct {
+	uint column_begin;
+	uint column_end;
+	uint row_begin;
+	uint row_end;
+} GridRange;
+
+Grid* Grid_create(float world_width, float world_height, float cell_size, uint capacity);
+void Grid_destroy(Grid* grid);
+
+void Grid_build(Grid* grid, Workers* workers, Tile* tiles, Vector2* offsets, uint count);
+void Grid_update(Grid* grid, Workers* workers, Tile* tiles, Vector2* offsets, uint count);
+void Grid_invalidate(Grid* grid);
+
+void Grid_balance(Grid* grid, uint range_count);
+uint* Grid_partition_slots(Grid* grid);
+
+// Positions outside the world fall into the nearest edge cell. The whole tiles and the offset are added up in double
+// precision, so an agent far out is keyed by the same cell boundaries as one at the origin
+static inline uint Grid_cell_of(Grid* grid, Tile tile, Vector2 offset) {
+	int column = (int) floor(((double) tile.x * TILE_SIZE + offset.x) / grid->cell_size);
+	int row = (int) floor(((double) tile.y * TILE_SIZE + offset.y) / grid->cell_size);
+
+	column = column < 0 ? 0 : (column >= (int) grid->world_columns ? (int) grid->world_columns - 1 : column);
+	row = row < 0 ? 0 : (row >= (int) grid->world_rows ? (int) grid->world_rows - 1 : row);
+
+	if(grid->folded) {
+		column %= grid->columns;
+		row %= grid->rows;
+	}
+
+	return (uint) row * grid->columns + (uint) column;
+}
+
+static inline GridRange Grid_neighbourhood(Grid* grid, Tile tile, Vector2 offset) {
+	uint cell = Grid_cell_of(grid, tile, offset);
+	uint column = cell % grid->columns;
+	uint row = cell / grid->columns;
+
+	// On the edge of a fold the neighbours are on the far side of the grid, so the whole row or column is searched
+	bool wrap_column = grid->world_columns > grid->columns && (column == 0 || column + 1 == grid->columns);
+	bool wrap_row = grid->world_rows > grid->rows && (row == 0 || row + 1 == grid->rows);
+
+	GridRange range;
+	range.column_begin = column > 0 && !wrap_column ? column - 1 : 0;
+	range.column_end = column + 1 < grid->columns && !wrap_column ? column + 1 : grid->columns - 1;
+	range.row_begin = row > 0 && !wrap_row ? row - 1 : 0;
+	range.row_end = row + 1 < grid->rows && !wrap_row ? row + 1 : grid->rows - 1;
+	return range;
+}
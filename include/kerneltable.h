@@ -0,0 +1,45 @@
+#pragma once
+#include <stdbool.h>
+
+#include "types.h"
+#include "parameters.h"
+
+// A function of the squared distance between two agents under one block of parameters
+typedef float (*KernelFunction)(float square_distance, const Parameters* parameters);
+
+// Samples of a kernel at evenly spaced squared distances up to range, linearly interpolated in between, so the inner
+// loops do a lookup instead of a division or a transcendental. A table is built from one parameter block and only built
+// again once that changes. Kernels that blow up at zero are only tabled from a floor on and the caller works out
+// anything closer itself, the floor is a squared distance so more entries always mean a closer fit
+typedef struct {
+	float* values;
+	uint size;
+
+	float floor;
+	float range;
+	float scale;
+
+	// Largest differences from the kernel between floor and range, measured between the samples after every build
+	float max_error;
+	float max_relative_error;
+
+	Parameters parameters;
+	bool built;
+} KernelTable;
+
+KernelTable* KernelTable_create(uint size);
+void KernelTable_destroy(KernelTable* table);
+
+// Build the table between the squared distances floor and range, unless it was last built from the same parameters.
+// Returns whether it was built again
+bool KernelTable_update(KernelTable* table, KernelFunction kernel, const Parameters* parameters, float range, float floor);
+
+// Squared distances past the range read the value at the range
+static inline float KernelTable_lookup(KernelTable* table, float square_distance) {
+	float position = square_distance * table->scale;
+	position = position < table->size ? position : table->size;
+
+	uint index = (uint) position;
+	float fraction = position - index;
+	return table->values[index] + (table->values[index + 1] - table->values[index]) * fraction;
+}
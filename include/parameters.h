@@ -0,0 +1,41 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+// Everything the simulation reads from the sliders and the command line, a block is never written again once it has
+// been published
+typedef struct {
+	uint version;
+
+	float social_distance;
+	float social_distance_factor;
+	float infection_radius;
+	float infection_chance;
+	float infection_falloff;
+	float infection_duration;
+} Parameters;
+
+// Triple buffer between one publishing thread and one latching thread. The publisher fills its own block and swaps it
+// into the shared slot, the latcher swaps the shared slot with the block it has been reading. Neither ever waits or
+// sees a block the other is still writing.
+typedef struct {
+	Parameters blocks[3];
+
+	// Index of the block in the shared slot, with PARAMETERS_FRESH set until it has been latched
+	atomic_uint shared;
+	uint back;
+	uint front;
+
+	uint version;
+} ParameterBuffer;
+
+ParameterBuffer* ParameterBuffer_create(const Parameters* initial);
+void ParameterBuffer_destroy(ParameterBuffer* buffer);
+
+// Publish a copy of the parameters under the next version
+void ParameterBuffer_publish(ParameterBuffer* buffer, const Parameters* parameters);
+
+// The newest published block, which stays untouched until the next latch. Sets fresh when it changed since the last one.
+const Parameters* ParameterBuffer_latch(ParameterBuffer* buffer, bool* fresh);
@@ -0,0 +1,99 @@
+#pragma once
+#include <raylib.h>
+
+#include "types.h"
+#include "workers.h"
+#include "fft.h"
+
+// Meshes that only need to be roughly right are spread out until they fit in this many nodes on a side
+#define MESH_MAX_SIZE 256
+
+// Kernel value at a distance, width is whatever scale the kernel was made with
+typedef float (*ParticleMeshKernel)(float distance, float width);
+
+// Particle mesh convolution. Agents are splatted onto the nodes of a grid, the grid is convolved with a radial kernel
+// through an FFT, and agents read the result, or its gradient, back by interpolating between nodes. The cost depends on
+// the grid and agent counts, not on how far the kernel reaches.
+typedef struct {
+	Fft* fft;
+
+	// Nodes covering the world, inside a size x size grid with enough padding that the convolution never wraps around
+	uint columns;
+	uint rows;
+	uint size;
+	float cell_size;
+
+	float width;
+	float inner;
+	float reach;
+
+	// Density on the way in, the convolved field on the way out
+	float* real;
+	float* imag;
+
+	// Transform of the kernel, already scaled for the inverse transform
+	float* kernel_real;
+	float* kernel_imag;
+} ParticleMesh;
+
+// Nodes are cell_size apart unless the grid would grow past max_size on a side, then they are spread out until it fits.
+// The kernel is zero beyond reach and held flat within inner_nodes of the centre, where the grid can't resolve it anyway
+ParticleMesh* ParticleMesh_create(float world_width, float world_height, float cell_size, float inner_nodes, float reach, ParticleMeshKernel kernel, float width, uint max_size);
+void ParticleMesh_destroy(ParticleMesh* mesh);
+
+void ParticleMesh_clear(ParticleMesh* mesh);
+
+// Cloud in cell, the weight is shared between the four nodes around the position
+void ParticleMesh_splat(ParticleMesh* mesh, Vector2 position, float weight);
+
+// Convolve the splatted density with the kernel, rows and columns are transformed across the workers
+void ParticleMesh_convolve(ParticleMesh* mesh, Workers* workers);
+
+// The node at or before a position and how far past it the position is, in nodes. The world starts at node one, so
+// every node a gradient reads is inside the grid
+static inline float* ParticleMesh_locate(ParticleMesh* mesh, Vector2 position, float* fx, float* fy) {
+	float x = position.x / mesh->cell_size + 1;
+	float y = position.y / mesh->cell_size + 1;
+
+	x = x < 1 ? 1 : (x > mesh->columns - 2.001f ? mesh->columns - 2.001f : x);
+	y = y < 1 ? 1 : (y > mesh->rows - 2.001f ? mesh->rows - 2.001f : y);
+
+	uint column = (uint) x;
+	uint row = (uint) y;
+	*fx = x - column;
+	*fy = y - row;
+
+	return mesh->real + row * mesh->size + column;
+}
+
+static inline float ParticleMesh_sample(ParticleMesh* mesh, Vector2 position) {
+	float fx, fy;
+	float* value = ParticleMesh_locate(mesh, position, &fx, &fy);
+
+	float top = value[0] + (value[1] - value[0]) * fx;
+	float bottom = value[mesh->size] + (value[mesh->size + 1] - value[mesh->size]) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// Central differences at the four nodes around the position, interpolated the same way as a sample
+static inline Vector2 ParticleMesh_sample_gradient(ParticleMesh* mesh, Vector2 position) {
+	float fx, fy;
+	float* value = ParticleMesh_locate(mesh, position, &fx, &fy);
+	uint size = mesh->size;
+
+	float x00 = value[1] - value[-1];
+	float x10 = value[2] - value[0];
+	float x01 = value[size + 1] - value[size - 1];
+	float x11 = value[size + 2] - value[size];
+
+	float y00 = value[size] - value[-(int) size];
+	float y10 = value[size + 1] - value[1 - (int) size];
+	float y01 = value[2 * size] - value[0];
+	float y11 = value[2 * size + 1] - value[1];
+
+	float scale = .5f / mesh->cell_size;
+	Vector2 gradient;
+	gradient.x = ((x00 + (x10 - x00) * fx) * (1 - fy) + (x01 + (x11 - x01) * fx) * fy) * scale;
+	gradient.y = ((y00 + (y10 - y00) * fx) * (1 - fy) + (y01 + (y11 - y01) * fx) * fy) * scale;
+	return gradient;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <raylib.h>
+
+#include "types.h"
+#include "workers.h"
+
+enum {
+	PLACEMENT_UNIFORM,
+	PLACEMENT_CLUSTERED,
+	PLACEMENT_POISSON,
+	PLACEMENT_MODE_COUNT
+};
+
+extern const char* placement_names[PLACEMENT_MODE_COUNT];
+
+// Where agents start out. Every mode runs in fixed chunks with one random stream per chunk, so the result only
+// depends on the seed and not on how many threads did the work.
+typedef struct {
+	byte mode;
+
+	float width;
+	float height;
+
+	// Clustered placement scatters agents normally around the hotspots
+	Vector2* hotspots;
+	ushort hotspot_count;
+	float cluster_spread;
+
+	uint seed;
+} Placement;
+
+void Placement_run(Placement* placement, Workers* workers, Vector2* positions, uint count);
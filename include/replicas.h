@@ -0,0 +1,54 @@
+#pragma once
+#include <raylib.h>
+
+#include "types.h"
+#include "parameters.h"
+
+// Replicas are stepped REPLICA_LANES at a time, one per vector lane
+#define REPLICA_LANES 8
+
+// Many small independent worlds sharing one set of parameters, stepped in lock-step. Replicas are grouped into blocks
+// of REPLICA_LANES, and within a block every array is agent major and replica minor: lane l of block b holds its agent
+// i at (b * agent_count + i) * REPLICA_LANES + l. The innermost loop of every pass runs over the lanes of a block, which
+// all do exactly the same thing, so the compiler steps every replica of the block with one instruction.
+// The last block is padded with replicas nobody reads. Replicas only wander and catch the disease, they don't make
+// trips to hotspots.
+typedef struct {
+	float* x;
+	float* y;
+	float* direction_x;
+	float* direction_y;
+	float* repulsion_x;
+	float* repulsion_y;
+	float* contacts;
+
+	// Agents infectious in at least one lane of their block, listed per block on every game tick
+	uint* spreaders;
+
+	byte* infected_periods;
+	byte* time_till_death;
+
+	// One while the agent is simulated and zero once it is removed, a float so it can weigh sums without a branch
+	float* simulated;
+
+	// Every replica draws from its own seed
+	uint* seeds;
+
+	uint replica_count;
+	uint block_count;
+	uint agent_count;
+	float world_width;
+	float world_height;
+} ReplicaBatch;
+
+ReplicaBatch* ReplicaBatch_create(uint replica_count, uint agent_count, float world_width, float world_height);
+void ReplicaBatch_destroy(ReplicaBatch* batch);
+
+// Scatter every replica's agents uniformly and infect its first agent, replica r is seeded with seed + r
+void ReplicaBatch_reset(ReplicaBatch* batch, const Parameters* parameters, uint seed);
+
+// Advance blocks [begin, end) by one frame, on game ticks the disease spreads before anyone moves. Replicas never read
+// each other, so disjoint blocks can run on different threads
+void ReplicaBatch_step(ReplicaBatch* batch, const Parameters* parameters, float delta, uint frame, uint tick, bool game_tick, uint begin, uint end);
+
+void ReplicaBatch_count(ReplicaBatch* batch, uint replica, uint* total_cases, uint* active_cases);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "types.h"
+
+// Counter based random numbers. The value only depends on its inputs, so any agent can draw its own numbers in any
+// order, on any thread, and still get the same result as a serial run with the same seed.
+static inline uint rng_mix(uint h) {
+	h ^= h >> 16;
+	h *= 0x7feb352d;
+	h ^= h >> 15;
+	h *= 0x846ca68b;
+	h ^= h >> 16;
+	return h;
+}
+
+static inline uint rng_hash(uint seed, uint key, uint counter, uint index) {
+	uint h = rng_mix(seed ^ 0x9e3779b9);
+	h = rng_mix(h ^ key);
+	h = rng_mix(h ^ counter);
+	return rng_mix(h ^ index);
+}
+
+// Uniform float in [0, 1)
+static inline float rng_uniform(uint seed, uint key, uint counter, uint index) {
+	return (rng_hash(seed, key, counter, index) >> 8) * (1.f / 16777216.f);
+}
+
+// Bulk generation. Each lane is an independent xoshiro128+ stream and the state is laid out lane by lane, so the
+// compiler can step every lane with a single vector instruction per operation.
+#define RNG_LANES 8
+
+typedef struct {
+	uint s[4][RNG_LANES];
+} Rng;
+
+void Rng_seed(Rng* rng, uint seed, uint stream);
+
+void Rng_fill_uniform(Rng* rng, float* out, uint count);
+void Rng_fill_normal(Rng* rng, float* out, uint count);
+
+// The same values as rng_uniform(seed, keys[i], counter, 0), computed for a whole array at once
+void rng_fill_hashed_uniform(float* out, uint seed, uint* keys, uint counter, uint count);
+
+// Polynomial sine and cosine over whole arrays, accurate to a few ulp for the angles the simulation produces
+void sincos_array(float* angles, float* sines, float* cosines, uint count);
@@ -0,0 +1,54 @@
+#pragma once
+#include <math.h>
+#include <raylib.h>
+
+#include "types.h"
+
+// A float keeps about seven significant digits, so a million units from the origin it can't step by less than a tenth
+// of a unit and small moves start to drift. Large worlds are cut into tiles instead, and agents move by their offset
+// within a tile, which stays small and exact however far out the tile is. Moving, bouncing off the walls and the keys
+// of the neighbour grid work on tiles and offsets, and drawing measures them from the tile in view. Everything else,
+// distances, repulsion, infection, meshes and flow fields, reads world positions put back together from both after
+// every move. Those are only good to a sixteenth of a unit a million units out, but the error never accumulates
+#define TILE_SIZE 4096.f
+
+typedef struct {
+	int x;
+	int y;
+} Tile;
+
+static inline Vector2 Tile_position(Tile tile, Vector2 offset) {
+	return (Vector2) { tile.x * TILE_SIZE + offset.x, tile.y * TILE_SIZE + offset.y };
+}
+
+static inline void Tile_split(Vector2 position, Tile* tile, Vector2* offset) {
+	float x = floorf(position.x / TILE_SIZE);
+	float y = floorf(position.y / TILE_SIZE);
+
+	tile->x = (int) x;
+	tile->y = (int) y;
+	offset->x = position.x - x * TILE_SIZE;
+	offset->y = position.y - y * TILE_SIZE;
+}
+
+// Position measured from the corner of another tile, the whole tiles in between are taken off as integers first
+static inline Vector2 Tile_relative(Tile tile, Vector2 offset, Tile origin) {
+	return (Vector2) { (tile.x - origin.x) * TILE_SIZE + offset.x, (tile.y - origin.y) * TILE_SIZE + offset.y };
+}
+
+// How far a wall a whole number of units along one axis is past a point on that axis. The whole tiles are taken off
+// as integers first, so the distance keeps the offset's precision however far out the wall is
+static inline float Tile_to_edge(int tile, float offset, long long edge) {
+	return (float) (edge - (long long) tile * (long long) TILE_SIZE) - offset;
+}
+
+// Carry whole tiles out of an offset that has moved past the edge of its tile
+static inline void Tile_carry(Tile* tile, Vector2* offset) {
+	float x = floorf(offset->x / TILE_SIZE);
+	float y = floorf(offset->y / TILE_SIZE);
+
+	tile->x += (int) x;
+	tile->y += (int) y;
+	offset->x -= x * TILE_SIZE;
+	offset->y -= y * TILE_SIZE;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+
+#include "types.h"
+
+// NUMA layout of the machine as far as the system reports it. Machines without any NUMA information, and every
+// system other than linux, show up as a single node holding every core. Node ids are the system's own, which can have
+// gaps, node_ids and node_memory are indexed from zero up to node_count
+typedef struct {
+	uint node_count;
+	uint* node_ids;
+	ulong* node_memory;
+
+	// Online cores ordered node by node, and the id of the node each one belongs to
+	uint cpu_count;
+	uint* cpus;
+	uint* cpu_nodes;
+} Topology;
+
+Topology* Topology_create();
+void Topology_destroy(Topology* topology);
+
+void Topology_print(Topology* topology);
+
+// Node id of the core at a position in cpus, wrapping around when there are more workers than cores
+uint Topology_node_of(Topology* topology, uint index);
+
+// Node the page holding an address lives on, -1 when the system can't tell
+int Topology_page_node(void* address);
@@ -0,0 +1,59 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+// A task is handed one chunk of items at a time. Chunks are fixed by the item count and chunk size alone, or by the
+// bounds they are given, so which thread runs a chunk never changes what the chunk computes, only when.
+typedef void (*WorkerTask)(void* data, uint chunk, uint begin, uint end, uint worker);
+
+typedef struct {
+	pthread_t* threads;
+	uint count;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+
+	WorkerTask task;
+	void* data;
+	uint item_count;
+	uint chunk_size;
+	uint chunk_count;
+
+	// When set, chunk c covers bounds[c] up to bounds[c + 1] instead
+	uint* bounds;
+
+	// Seconds each worker has spent running tasks since the last Workers_reset_busy
+	double* busy_time;
+
+	// Pinned workers stay on one core each and always run the same block of chunks, so they keep working on the
+	// memory they touched first instead of pulling whatever chunk is next
+	bool pinned;
+
+	atomic_uint next_chunk;
+	uint generation;
+	uint busy;
+	bool quit;
+} Workers;
+
+// thread_count of 0 uses one thread per core, the calling thread always works as worker 0
+Workers* Workers_create(uint thread_count);
+void Workers_destroy(Workers* workers);
+
+void Workers_run(Workers* workers, WorkerTask task, void* data, uint item_count, uint chunk_size);
+void Workers_run_ranges(Workers* workers, WorkerTask task, void* data, uint* bounds, uint range_count);
+
+void Workers_reset_busy(Workers* workers);
+
+// Pin worker i to cpus[i % cpu_count], returns false when the system doesn't support it
+bool Workers_pin(Workers* workers, uint* cpus, uint cpu_count);
+
+uint cpu_count();
+double time_now();
+
+// Sum values (spaced stride apart) by splitting them in halves recursively. The tree only depends on the count, so
+// per chunk partial results always combine in the same order
+double reduce_pairwise(double* values, uint count, uint stride);
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#include "../include/arena.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static size_t align_up(size_t size, size_t alignment) {
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Reserve the arena's memory, preferring explicit huge pages, then transparent huge pages, then whatever the system gives us
+static void Arena_allocate(Arena* arena) {
+#if defined(__linux__)
+	size_t length = align_up(arena->capacity, HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+	arena->memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(arena->memory != MAP_FAILED) {
+		arena->capacity = length;
+		arena->huge_pages = true;
+		arena->mapped = true;
+		return;
+	}
+#endif
+
+	arena->memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(arena->memory != MAP_FAILED) {
+		arena->capacity = length;
+		arena->mapped = true;
+#ifdef MADV_HUGEPAGE
+		arena->huge_pages = madvise(arena->memory, length, MADV_HUGEPAGE) == 0;
+#endif
+		return;
+	}
+
+	arena->memory = NULL;
+#endif
+
+	arena->capacity = align_up(arena->capacity, ARENA_ALIGNMENT);
+#if defined(_WIN32)
+	arena->memory = (byte*) _aligned_malloc(arena->capacity, ARENA_ALIGNMENT);
+#else
+	arena->memory = (byte*) aligned_alloc(ARENA_ALIGNMENT, arena->capacity);
+#endif
+}
+
+Arena* Arena_create(size_t capacity) {
+	Arena* arena = (Arena*) malloc(sizeof(Arena));
+	arena->capacity = capacity > 0 ? capacity : ARENA_ALIGNMENT;
+	arena->used = 0;
+	arena->huge_pages = false;
+	arena->mapped = false;
+	arena->memory = NULL;
+
+	Arena_allocate(arena);
+	return arena;
+}
+
+void Arena_destroy(Arena* arena) {
+	if(arena == NULL)
+		return;
+
+#if defined(__linux__)
+	if(arena->mapped)
+		munmap(arena->memory, arena->capacity);
+#endif
+
+	if(!arena->mapped && arena->memory != NULL) {
+#if defined(_WIN32)
+		_aligned_free(arena->memory);
+#else
+		free(arena->memory);
+#endif
+	}
+
+	free(arena);
+}
+
+// Returns NULL when measuring or when the arena is full
+void* Arena_push(Arena* arena, size_t size) {
+	size_t offset = align_up(arena->used, ARENA_ALIGNMENT);
+	arena->used = offset + align_up(size, ARENA_ALIGNMENT);
+
+	if(arena->memory == NULL || arena->used > arena->capacity)
+		return NULL;
+
+	return arena->memory + offset;
+}
+
+// Forget every allocation but keep the memory around for the next layout
+void Arena_reset(Arena* arena) {
+	arena->used = 0;
+}
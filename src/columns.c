@@ -0,0 +1,88 @@
+#include <string.h>
+
+#include "../include/columns.h"
+
+// Returns false once the registry is full, the column then never gets any memory
+bool Columns_add(Columns* columns, const char* name, void** data, size_t element_size, byte flags) {
+	if(columns->count >= COLUMN_MAX)
+		return false;
+
+	columns->columns[columns->count++] = (Column) { name, data, element_size, flags };
+	*data = NULL;
+	return true;
+}
+
+static size_t column_bytes(Column* column, uint count) {
+	if(column->flags & COLUMN_BITS)
+		return sizeof(uint) * Columns_bit_words(count);
+
+	return column->element_size * count;
+}
+
+// Push every column onto an arena without handing any of them out, so the columns in use stay where they are
+void Columns_measure(Columns* columns, Arena* arena, uint count) {
+	for(uint i = 0; i < columns->count; i++)
+		Arena_push(arena, column_bytes(&columns->columns[i], count));
+}
+
+// Measuring leaves every column NULL, the same as the arena it is pushed onto
+void Columns_layout(Columns* columns, Arena* arena, uint count) {
+	for(uint i = 0; i < columns->count; i++) {
+		Column* column = &columns->columns[i];
+		*column->data = Arena_push(arena, column_bytes(column, count));
+	}
+}
+
+// Zero the range [begin, end) of every column
+void Columns_clear(Columns* columns, uint begin, uint end) {
+	for(uint i = 0; i < columns->count; i++) {
+		Column* column = &columns->columns[i];
+		byte* data = (byte*) *column->data;
+
+		if(column->flags & COLUMN_BITS) {
+			size_t first = begin / COLUMN_WORD_BITS;
+			memset(data + sizeof(uint) * first, 0, sizeof(uint) * (Columns_bit_words(end) - first));
+		}
+
+		else
+			memset(data + column->element_size * begin, 0, column->element_size * (end - begin));
+	}
+}
+
+// Slot i of every permuted column takes the element from slot order[i], for the first count slots. The scratch has to
+// hold count elements of the widest column
+void Columns_permute(Columns* columns, uint* order, uint count, byte* scratch) {
+	for(uint c = 0; c < columns->count; c++) {
+		Column* column = &columns->columns[c];
+		if(!(column->flags & COLUMN_PERMUTED))
+			continue;
+
+		if(column->flags & COLUMN_BITS) {
+			uint* bits = (uint*) *column->data;
+			uint* words = (uint*) scratch;
+			size_t word_count = Columns_bit_words(count);
+
+			memset(words, 0, sizeof(uint) * word_count);
+			for(uint i = 0; i < count; i++)
+				words[i / COLUMN_WORD_BITS] |= (uint) Columns_bit(bits, order[i]) << (i % COLUMN_WORD_BITS);
+
+			// Bits past count in the last word belong to agents that stay where they are
+			uint tail = count % COLUMN_WORD_BITS;
+			if(tail > 0) {
+				uint mask = (1u << tail) - 1;
+				words[word_count - 1] |= bits[word_count - 1] & ~mask;
+			}
+
+			memcpy(bits, words, sizeof(uint) * word_count);
+			continue;
+		}
+
+		byte* elements = (byte*) *column->data;
+		size_t size = column->element_size;
+
+		for(uint i = 0; i < count; i++)
+			memcpy(scratch + i * size, elements + order[i] * size, size);
+
+		memcpy(elements, scratch, size * count);
+	}
+}
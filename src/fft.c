@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "../include/fft.h"
+
+Fft* Fft_create(uint size) {
+	Fft* fft = (Fft*) malloc(sizeof(Fft));
+	fft->size = size;
+	fft->reversed = (uint*) malloc(sizeof(uint) * size);
+	fft->cosines = (float*) malloc(sizeof(float) * (size / 2 + 1));
+	fft->sines = (float*) malloc(sizeof(float) * (size / 2 + 1));
+
+	uint bits = 0;
+	while((1u << bits) < size)
+		bits++;
+
+	for(uint i = 0; i < size; i++) {
+		uint reversed = 0;
+		for(uint bit = 0; bit < bits; bit++)
+			reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+
+		fft->reversed[i] = reversed;
+	}
+
+	// Twiddles are worked out in double so the large transforms don't pile up rounding error
+	for(uint k = 0; k <= size / 2; k++) {
+		fft->cosines[k] = (float) cos(2 * M_PI * k / size);
+		fft->sines[k] = (float) sin(2 * M_PI * k / size);
+	}
+
+	return fft;
+}
+
+void Fft_destroy(Fft* fft) {
+	if(fft == NULL)
+		return;
+
+	free(fft->reversed);
+	free(fft->cosines);
+	free(fft->sines);
+	free(fft);
+}
+
+void Fft_run(Fft* fft, float* real, float* imag, uint stride, bool inverse) {
+	uint size = fft->size;
+	float direction = inverse ? 1.f : -1.f;
+
+	for(uint i = 0; i < size; i++) {
+		uint j = fft->reversed[i];
+		if(i >= j)
+			continue;
+
+		float r = real[i * stride];
+		float m = imag[i * stride];
+		real[i * stride] = real[j * stride];
+		imag[i * stride] = imag[j * stride];
+		real[j * stride] = r;
+		imag[j * stride] = m;
+	}
+
+	// Combine pairs of half length transforms into ever longer ones
+	for(uint length = 2; length <= size; length <<= 1) {
+		uint half = length / 2;
+		uint step = size / length;
+
+		for(uint start = 0; start < size; start += length) {
+			for(uint k = 0; k < half; k++) {
+				float wr = fft->cosines[k * step];
+				float wi = direction * fft->sines[k * step];
+
+				uint a = (start + k) * stride;
+				uint b = (start + k + half) * stride;
+
+				float tr = real[b] * wr - imag[b] * wi;
+				float ti = real[b] * wi + imag[b] * wr;
+
+				real[b] = real[a] - tr;
+				imag[b] = imag[a] - ti;
+				real[a] += tr;
+				imag[a] += ti;
+			}
+		}
+	}
+}
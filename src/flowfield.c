@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include <raylib.h>
+#include <raymath.h>
+
+#include "../include/flowfield.h"
+
+#define FLOW_UNREACHED 1e30f
+
+// Building visits every cell, so a very large world gets coarser cells rather than more of them
+#define FLOW_MAX_CELLS (1u << 18)
+
+typedef struct {
+	uint cell;
+	float cost;
+} FlowNode;
+
+FlowField* FlowField_create(float world_width, float world_height, float cell_size) {
+	FlowField* field = (FlowField*) malloc(sizeof(FlowField));
+
+	while(ceilf(world_width / cell_size) * ceilf(world_height / cell_size) > FLOW_MAX_CELLS)
+		cell_size *= 1.25f;
+
+	field->cell_size = cell_size;
+	field->columns = (ushort) ceilf(world_width / cell_size);
+	field->rows = (ushort) ceilf(world_height / cell_size);
+
+	uint cell_count = (uint) field->columns * field->rows;
+	field->directions = (Vector2*) calloc(cell_count, sizeof(Vector2));
+	field->costs = (float*) malloc(sizeof(float) * cell_count);
+
+	field->target = (Vector2) { 0 };
+	return field;
+}
+
+void FlowField_destroy(FlowField* field) {
+	if(field == NULL)
+		return;
+
+	free(field->directions);
+	free(field->costs);
+	free(field);
+}
+
+static bool cell_blocked(FlowField* field, uint column, uint row, Rectangle* obstacles, ushort obstacle_count) {
+	Vector2 center = { (column + .5f) * field->cell_size, (row + .5f) * field->cell_size };
+
+	for(ushort i = 0; i < obstacle_count; i++) {
+		Rectangle r = obstacles[i];
+		if(center.x >= r.x && center.x < r.x + r.width && center.y >= r.y && center.y < r.y + r.height)
+			return true;
+	}
+
+	return false;
+}
+
+// Binary min heap keyed on path cost, duplicates are allowed and stale entries are skipped when popped
+static void heap_push(FlowNode* heap, uint* size, FlowNode node) {
+	uint i = (*size)++;
+	while(i > 0) {
+		uint parent = (i - 1) / 2;
+		if(heap[parent].cost <= node.cost)
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = node;
+}
+
+static FlowNode heap_pop(FlowNode* heap, uint* size) {
+	FlowNode top = heap[0];
+	FlowNode last = heap[--(*size)];
+
+	uint i = 0;
+	while(1) {
+		uint child = i * 2 + 1;
+		if(child >= *size)
+			break;
+		if(child + 1 < *size && heap[child + 1].cost < heap[child].cost)
+			child++;
+		if(last.cost <= heap[child].cost)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+
+	return top;
+}
+
+static const int neighbour_dx[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int neighbour_dy[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+static const float neighbour_cost[8] = { 1, 1, 1, 1, 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+
+// Run Dijkstra outwards from the target cell over an 8 connected grid, then point every cell at its cheapest neighbour
+void FlowField_build(FlowField* field, Vector2 target, Rectangle* obstacles, ushort obstacle_count) {
+	int columns = field->columns;
+	int rows = field->rows;
+	uint cell_count = (uint) columns * rows;
+
+	field->target = target;
+
+	bool* blocked = (bool*) malloc(sizeof(bool) * cell_count);
+	for(int row = 0; row < rows; row++) {
+		for(int column = 0; column < columns; column++)
+			blocked[row * columns + column] = cell_blocked(field, column, row, obstacles, obstacle_count);
+	}
+
+	for(uint i = 0; i < cell_count; i++)
+		field->costs[i] = FLOW_UNREACHED;
+
+	int target_column = Clamp((int) (target.x / field->cell_size), 0, columns - 1);
+	int target_row = Clamp((int) (target.y / field->cell_size), 0, rows - 1);
+	uint target_cell = target_row * columns + target_column;
+
+	FlowNode* heap = (FlowNode*) malloc(sizeof(FlowNode) * cell_count * 8 + sizeof(FlowNode));
+	uint heap_size = 0;
+
+	field->costs[target_cell] = 0;
+	heap_push(heap, &heap_size, (FlowNode) { target_cell, 0 });
+
+	while(heap_size > 0) {
+		FlowNode node = heap_pop(heap, &heap_size);
+		if(node.cost > field->costs[node.cell])
+			continue;
+
+		int column = node.cell % columns;
+		int row = node.cell / columns;
+
+		for(int n = 0; n < 8; n++) {
+			int nc = column + neighbour_dx[n];
+			int nr = row + neighbour_dy[n];
+
+			if(nc < 0 || nr < 0 || nc >= columns || nr >= rows)
+				continue;
+
+			uint neighbour = nr * columns + nc;
+			if(blocked[neighbour])
+				continue;
+
+			// Don't let diagonal steps cut across the corner of an obstacle
+			if(n >= 4 && (blocked[row * columns + nc] || blocked[nr * columns + column]))
+				continue;
+
+			float cost = node.cost + neighbour_cost[n];
+			if(cost < field->costs[neighbour]) {
+				field->costs[neighbour] = cost;
+				heap_push(heap, &heap_size, (FlowNode) { neighbour, cost });
+			}
+		}
+	}
+
+	for(int row = 0; row < rows; row++) {
+		for(int column = 0; column < columns; column++) {
+			uint cell = row * columns + column;
+			Vector2 center = { (column + .5f) * field->cell_size, (row + .5f) * field->cell_size };
+			Vector2 direction = { 0 };
+
+			if(cell == target_cell) {
+				direction = Vector2Subtract(target, center);
+			}
+
+			else if(field->costs[cell] < FLOW_UNREACHED) {
+				float best_cost = field->costs[cell];
+
+				for(int n = 0; n < 8; n++) {
+					int nc = column + neighbour_dx[n];
+					int nr = row + neighbour_dy[n];
+
+					if(nc < 0 || nr < 0 || nc >= columns || nr >= rows)
+						continue;
+
+					float cost = field->costs[nr * columns + nc];
+					if(cost < best_cost) {
+						best_cost = cost;
+						direction = (Vector2) { neighbour_dx[n], neighbour_dy[n] };
+					}
+				}
+			}
+
+			float length = Vector2Length(direction);
+			field->directions[cell] = length > 0 ? Vector2Scale(direction, 1.f / length) : (Vector2) { 0 };
+		}
+	}
+
+	free(heap);
+	free(blocked);
+}
@@ -17,6 +17,10 @@ void Graph_destroy(Graph* graph) {
 		free(graph);
 }
 
+void Graph_clear(Graph* graph) {
+	graph->current_point = 0;
+}
+
 
 float Graph_get_highest_value(Graph* graph) {
 	float highest_value = graph->data_points[0];
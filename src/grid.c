@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/grid.h"
+
+// Binning every agent only reads its own position, so it is split across the workers
+#define GRID_CHUNK 16384
+
+// The incremental grid gives every cell room for a quarter more agents than it had, and a few more for empty cells
+#define GRID_SLACK_MIN 4
+
+// Lay everything out again once this many agents in every hundred have moved cell, to get every cell back into agent
+// index order
+#define GRID_RELAYOUT_PERCENT 25
+
+// When this many agents in every hundred cross into another cell in a single update, moving them one at a time costs
+// more than laying everything out again
+#define GRID_CROSSING_PERCENT 5
+
+// A world with more cells than this folds onto a grid this many cells across, most of a very large world is empty and
+// would otherwise need more memory for its cells than for its agents
+#define GRID_MAX_CELLS (1u << 20)
+#define GRID_FOLD_SIZE 1024
+
+typedef struct {
+	Grid* grid;
+	Tile* tiles;
+	Vector2* offsets;
+
+	// Count the agents that changed cell while binning, only when the current cells are still valid
+	bool compare;
+} GridJob;
+
+Grid* Grid_create(float world_width, float world_height, float cell_size, uint capacity) {
+	Grid* grid = (Grid*) malloc(sizeof(Grid));
+	grid->cell_size = cell_size;
+	grid->world_columns = (uint) ceilf(world_width / cell_size);
+	grid->world_rows = (uint) ceilf(world_height / cell_size);
+	grid->world_columns += grid->world_columns == 0;
+	grid->world_rows += grid->world_rows == 0;
+
+	grid->folded = (ulong) grid->world_columns * grid->world_rows > GRID_MAX_CELLS;
+	grid->columns = grid->folded && grid->world_columns > GRID_FOLD_SIZE ? GRID_FOLD_SIZE : grid->world_columns;
+	grid->rows = grid->folded && grid->world_rows > GRID_FOLD_SIZE ? GRID_FOLD_SIZE : grid->world_rows;
+	grid->cell_count = grid->columns * grid->rows;
+
+	grid->capacity = capacity;
+	grid->count = 0;
+
+	// Room for the slack of the incremental grid, a compact build only uses the first capacity slots
+	grid->slot_capacity = capacity + capacity / 4 + grid->cell_count * GRID_SLACK_MIN;
+	grid->slot_count = 0;
+
+	grid->cell_starts = (uint*) calloc(grid->cell_count + 1, sizeof(uint));
+	grid->cell_counts = (uint*) calloc(grid->cell_count, sizeof(uint));
+	grid->cells = (uint*) malloc(sizeof(uint) * capacity);
+	grid->next_cells = (uint*) malloc(sizeof(uint) * capacity);
+	grid->agents = (uint*) malloc(sizeof(uint) * grid->slot_capacity);
+	grid->slots = (uint*) malloc(sizeof(uint) * capacity);
+
+	grid->incremental = false;
+	grid->moved = 0;
+	grid->crossed = 0;
+	grid->layouts = 0;
+	grid->chunk_crossed = (uint*) calloc(capacity / GRID_CHUNK + 1, sizeof(uint));
+
+	grid->partition = NULL;
+	grid->partition_slots = NULL;
+	grid->partition_count = 0;
+
+	return grid;
+}
+
+void Grid_destroy(Grid* grid) {
+	if(grid == NULL)
+		return;
+
+	free(grid->cell_starts);
+	free(grid->cell_counts);
+	free(grid->cells);
+	free(grid->next_cells);
+	free(grid->agents);
+	free(grid->slots);
+	free(grid->chunk_crossed);
+	free(grid->partition);
+	free(grid->partition_slots);
+	free(grid);
+}
+
+static void Grid_bin_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	GridJob* job = (GridJob*) data;
+	Grid* grid = job->grid;
+
+	for(uint i = begin; i < end; i++)
+		grid->next_cells[i] = Grid_cell_of(grid, job->tiles[i], job->offsets[i]);
+
+	if(!job->compare)
+		return;
+
+	uint crossed = 0;
+	for(uint i = begin; i < end; i++)
+		crossed += grid->next_cells[i] != grid->cells[i];
+
+	grid->chunk_crossed[chunk] = crossed;
+}
+
+// Counting sort over the freshly binned cells, agents are in index order within a cell so the result never depends on
+// the thread count. With slack every cell gets spare room behind its agents, marked empty
+static void Grid_layout(Grid* grid, bool slack) {
+	uint* swap = grid->cells;
+	grid->cells = grid->next_cells;
+	grid->next_cells = swap;
+
+	uint* cell_starts = grid->cell_starts;
+	uint* cell_counts = grid->cell_counts;
+	memset(cell_counts, 0, sizeof(uint) * grid->cell_count);
+
+	for(uint i = 0; i < grid->count; i++)
+		cell_counts[grid->cells[i]]++;
+
+	cell_starts[0] = 0;
+	for(uint cell = 0; cell < grid->cell_count; cell++) {
+		uint space = cell_counts[cell];
+		if(slack)
+			space += cell_counts[cell] / 4 + GRID_SLACK_MIN;
+
+		cell_starts[cell + 1] = cell_starts[cell] + space;
+	}
+
+	grid->slot_count = cell_starts[grid->cell_count];
+	memset(cell_counts, 0, sizeof(uint) * grid->cell_count);
+
+	for(uint i = 0; i < grid->count; i++) {
+		uint cell = grid->cells[i];
+		uint slot = cell_starts[cell] + cell_counts[cell]++;
+		grid->agents[slot] = i;
+		grid->slots[i] = slot;
+	}
+
+	if(slack) {
+		for(uint cell = 0; cell < grid->cell_count; cell++) {
+			for(uint slot = cell_starts[cell] + cell_counts[cell]; slot < cell_starts[cell + 1]; slot++)
+				grid->agents[slot] = GRID_EMPTY;
+		}
+	}
+
+	grid->incremental = slack;
+	grid->moved = 0;
+	grid->layouts++;
+}
+
+void Grid_build(Grid* grid, Workers* workers, Tile* tiles, Vector2* offsets, uint count) {
+	GridJob job = { grid, tiles, offsets, false };
+	grid->count = count < grid->capacity ? count : grid->capacity;
+
+	Workers_run(workers, Grid_bin_chunk, &job, grid->count, GRID_CHUNK);
+	Grid_layout(grid, false);
+}
+
+// Move one agent from the end of its old cell's agents into the slack of its new cell, the last agent of the old cell
+// fills the gap. Returns false when the new cell has no room left
+static bool Grid_move(Grid* grid, uint i, uint cell) {
+	if(grid->cell_starts[cell] + grid->cell_counts[cell] >= grid->cell_starts[cell + 1])
+		return false;
+
+	uint old_cell = grid->cells[i];
+	uint last = grid->cell_starts[old_cell] + --grid->cell_counts[old_cell];
+	uint moved = grid->agents[last];
+
+	grid->agents[grid->slots[i]] = moved;
+	grid->slots[moved] = grid->slots[i];
+	grid->agents[last] = GRID_EMPTY;
+
+	uint slot = grid->cell_starts[cell] + grid->cell_counts[cell]++;
+	grid->agents[slot] = i;
+	grid->slots[i] = slot;
+	grid->cells[i] = cell;
+	return true;
+}
+
+// Binning runs on every agent, but only the ones that crossed into another cell are moved. Agents are moved in index
+// order, so the result still doesn't depend on the thread count. It does depend on the updates before it, the agents
+// in a cell end up in a different order than a full build would put them in. When too many agents crossed at once the
+// update is a full build instead, and the next update lays out the slack again
+void Grid_update(Grid* grid, Workers* workers, Tile* tiles, Vector2* offsets, uint count) {
+	count = count < grid->capacity ? count : grid->capacity;
+
+	// Compacting the population reorders its slots, so the old layout means nothing any more
+	bool relayout = count != grid->count;
+	grid->count = count;
+
+	GridJob job = { grid, tiles, offsets, !relayout };
+	Workers_run(workers, Grid_bin_chunk, &job, grid->count, GRID_CHUNK);
+
+	grid->crossed = 0;
+	for(uint chunk = 0; chunk * GRID_CHUNK < grid->count && !relayout; chunk++)
+		grid->crossed += grid->chunk_crossed[chunk];
+
+	if(!relayout && (ulong) grid->crossed * 100 > (ulong) grid->count * GRID_CROSSING_PERCENT) {
+		Grid_layout(grid, false);
+		return;
+	}
+
+	relayout |= !grid->incremental;
+
+	for(uint i = 0; i < grid->count && !relayout; i++) {
+		if(grid->next_cells[i] == grid->cells[i])
+			continue;
+
+		relayout = !Grid_move(grid, i, grid->next_cells[i]);
+		grid->moved++;
+	}
+
+	if(relayout || grid->moved * 100 > (ulong) grid->count * GRID_RELAYOUT_PERCENT)
+		Grid_layout(grid, true);
+}
+
+// Forget the current build, so the next update or steering frame bins every agent again and the partition is redone
+void Grid_invalidate(Grid* grid) {
+	if(grid == NULL)
+		return;
+
+	grid->count = 0;
+	grid->incremental = false;
+	grid->moved = 0;
+	grid->partition_count = 0;
+}
+
+// An agent costs about one check for every agent in the block of cells around it, so that is what a cell weighs
+static double Grid_cell_weight(Grid* grid, uint cell) {
+	uint column = cell % grid->columns;
+	uint row = cell / grid->columns;
+	uint column_begin = column > 0 ? column - 1 : 0;
+	uint column_end = column + 1 < grid->columns ? column + 1 : column;
+	uint row_begin = row > 0 ? row - 1 : 0;
+	uint row_end = row + 1 < grid->rows ? row + 1 : row;
+
+	uint block = 0;
+	for(uint r = row_begin; r <= row_end; r++) {
+		for(uint c = column_begin; c <= column_end; c++)
+			block += grid->cell_counts[r * grid->columns + c];
+	}
+
+	return (double) grid->cell_counts[cell] * (block + 1);
+}
+
+// Split the cells into ranges of about equal weight from the current build, cells are in row order so every range is
+// also a run of slots. Crowds move slowly, so the split only needs redoing every so often
+void Grid_balance(Grid* grid, uint range_count) {
+	if(grid->partition_count != range_count) {
+		grid->partition = (uint*) realloc(grid->partition, sizeof(uint) * (range_count + 1));
+		grid->partition_slots = (uint*) realloc(grid->partition_slots, sizeof(uint) * (range_count + 1));
+		grid->partition_count = range_count;
+	}
+
+	double total = 0;
+	for(uint cell = 0; cell < grid->cell_count; cell++)
+		total += Grid_cell_weight(grid, cell);
+
+	uint range = 1;
+	double running = 0;
+	grid->partition[0] = 0;
+
+	for(uint cell = 0; cell < grid->cell_count && range < range_count; cell++) {
+		while(range < range_count && running >= total * range / range_count)
+			grid->partition[range++] = cell;
+
+		running += Grid_cell_weight(grid, cell);
+	}
+
+	while(range <= range_count)
+		grid->partition[range++] = grid->cell_count;
+}
+
+// The slots each range covers move with every build even while the cells stay put. Ranges over the incremental grid
+// take in the empty slack too
+uint* Grid_partition_slots(Grid* grid) {
+	for(uint range = 0; range <= grid->partition_count; range++)
+		grid->partition_slots[range] = grid->cell_starts[grid->partition[range]];
+
+	return grid->partition_slots;
+}
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/kerneltable.h"
+
+// Points checked against the kernel between every two samples to measure the error
+#define KERNEL_ERROR_SAMPLES 8
+
+KernelTable* KernelTable_create(uint size) {
+	KernelTable* table = (KernelTable*) malloc(sizeof(KernelTable));
+
+	// One sample past the range so a lookup right at the range still has a neighbour to interpolate towards
+	table->values = (float*) calloc(size + 2, sizeof(float));
+	table->size = size;
+
+	table->floor = 0;
+	table->range = 0;
+	table->scale = 0;
+	table->max_error = 0;
+	table->max_relative_error = 0;
+
+	memset(&table->parameters, 0, sizeof(Parameters));
+	table->built = false;
+	return table;
+}
+
+void KernelTable_destroy(KernelTable* table) {
+	if(table == NULL)
+		return;
+
+	free(table->values);
+	free(table);
+}
+
+bool KernelTable_update(KernelTable* table, KernelFunction kernel, const Parameters* parameters, float range, float floor) {
+	if(table->built && table->range == range && table->floor == floor && !memcmp(&table->parameters, parameters, sizeof(Parameters)))
+		return false;
+
+	float step = range / table->size;
+	table->range = range;
+	table->scale = table->size / range;
+	table->floor = floor;
+
+	// Samples closer than the floor are only read by the lookups between the floor and the next sample, they take the
+	// value at the floor so nothing blows up
+	uint first = (uint) ceilf(floor / step);
+	first = first < table->size ? first : table->size;
+
+	for(uint i = 0; i <= table->size; i++)
+		table->values[i] = kernel(i < first ? floor : i * step, parameters);
+
+	table->values[table->size + 1] = table->values[table->size];
+
+	table->max_error = 0;
+	table->max_relative_error = 0;
+
+	for(uint i = first > 0 ? first - 1 : 0; i < table->size; i++) {
+		for(uint sample = 0; sample < KERNEL_ERROR_SAMPLES; sample++) {
+			float square_distance = (i + (sample + .5f) / KERNEL_ERROR_SAMPLES) * step;
+			if(square_distance < floor)
+				continue;
+
+			float exact = kernel(square_distance, parameters);
+			float error = fabsf(KernelTable_lookup(table, square_distance) - exact);
+
+			table->max_error = error > table->max_error ? error : table->max_error;
+			if(exact != 0 && error / fabsf(exact) > table->max_relative_error)
+				table->max_relative_error = error / fabsf(exact);
+		}
+	}
+
+	table->parameters = *parameters;
+	table->built = true;
+	return true;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include <raylib.h>
@@ -8,375 +9,2988 @@
 #include "../include/types.h"
 #include "../include/graph.h"
 #include "../include/slider.h"
+#include "../include/flowfield.h"
+#include "../include/arena.h"
+#include "../include/rng.h"
+#include "../include/workers.h"
+#include "../include/placement.h"
+#include "../include/grid.h"
+#include "../include/topology.h"
+#include "../include/parameters.h"
+#include "../include/replicas.h"
+#include "../include/particlemesh.h"
+#include "../include/tiles.h"
+#include "../include/kerneltable.h"
+#include "../include/columns.h"
+
+#define MAX_HOTSPOTS 16
+
+// Above this many agents the pairwise distance matrix no longer fits in memory, distances are computed as needed instead
+#define DENSE_AGENT_LIMIT 8192
+
+// Without the matrix neighbours come from a uniform grid, its cells are as wide as the largest social distance the
+// sliders allow so every interaction range is covered by the block of cells around an agent
+#define GRID_CELL_SIZE 120
+
+// Chance of catching the disease from k infectious neighbours at once, precomputed for every k up to this
+#define INFECTION_TABLE_SIZE 256
+
+// The vector infection kernel tests this many candidates at once
+#define INFECTION_LANES 8
+
+// Balanced neighbour passes split the grid into this many ranges of about equal work, redone every few ticks
+#define BALANCE_RANGES 64
+#define REBALANCE_TICKS 5
+
+// Chunks wake a little before the epidemic reaches them, so steering has settled by the time infections can arrive
+#define WAKE_MARGIN 50
+
+// The dose falloff is cut off this many sigmas out, its mesh has nodes this many to a sigma
+#define EXPOSURE_REACH 4
+#define EXPOSURE_NODES_PER_SIGMA 2
+
+// The repulsion mesh is this many nodes on a side whatever the social distance, the world takes up the first half so
+// the padding holds any reach up to about the world's size. It only carries the push from agents further than a few
+// nodes away, closer ones are summed directly. Its transforms cost the same however many agents there are, so it only
+// pays off once an agent has about this many neighbours past the near field
+#define REPULSION_MESH_SIZE 256
+#define REPULSION_NEAR_NODES 2
+#define REPULSION_MESH_MIN_FAR 64
+
+// World the repulsion bench spreads the agents over for its last row, far larger than any mesh can cover
+#define BENCH_LARGE_WORLD 1000000
+
+// The repulsion weight blows up at zero, the kernel bench only tables it from this distance on
+#define BENCH_REPULSION_FLOOR 1
+
+// Walkers slow down with density along Weidmann's curve, 1.913 / 5.4 is its falloff over the jam density. They never
+// quite stop, a jammed cell would hold on to its agents forever
+#define CROWD_FALLOFF .354f
+#define CROWD_MIN_SPEED .1f
+
+// Agents are reset in fixed chunks, each with its own random stream
+#define RESET_CHUNK 16384
+
+// Every simulation pass is split into chunks of a fixed size, never into one piece per thread, so the work a chunk does
+// and the order partial results are combined in are the same whatever the thread count
+#define SIM_CHUNK 4096
+#define DISTANCE_CHUNK 64
+
+// Headless runs advance at a fixed 60 frames per second with a game tick every sixth frame
+#define FIXED_DELTA (1.f / 60.f)
+#define FRAMES_PER_TICK 6
+
+// Agents move at up to 90 units a second along each axis, so never faster than this
+#define MAX_SPEED (90.f * 1.41421356f)
+#define MAX_SUBSTEPS 16
+
+// Sensitivity studies run this many small worlds side by side
+#define REPLICA_BENCH_COUNT 64
+
+// Counter based random streams, each kind of draw gets its own so they never line up
+enum {
+	STREAM_INFECTION,
+	STREAM_NOISE_X,
+	STREAM_NOISE_Y,
+	STREAM_AGING,
+	STREAM_TRIPS,
+	STREAM_LOCKDOWN
+};
+
+// Per chunk partial sums gathered by agents_count
+enum {
+	STAT_CASES,
+	STAT_ACTIVE_CASES,
+	STAT_REMOVED,
+	STAT_CENTER_X,
+	STAT_CENTER_Y,
+	STAT_COUNT
+};
+
+// How a game tick decides who catches the disease. Contact draws once for every infectious neighbour of a susceptible
+// agent, aggregate draws once per susceptible agent from its neighbour count, skip has every infectious agent jump
+// straight to the neighbours it infects, and vector has every infectious agent test its candidates a block at a time.
+// Field drops the hard radius, every agent catches it from the dose it gets under a smooth falloff
+enum {
+	INFECTION_CONTACT,
+	INFECTION_AGGREGATE,
+	INFECTION_SKIP,
+	INFECTION_VECTOR,
+	INFECTION_FIELD,
+	INFECTION_KERNEL_COUNT
+};
+
+const char* infection_kernel_names[INFECTION_KERNEL_COUNT] = { "contact", "aggregate", "skip", "vector", "field" };
+
+// Agents wander by default and every now and then make a trip to a hotspot and back to where they left from
+enum {
+	TRIP_NONE,
+	TRIP_OUTBOUND,
+	TRIP_VISITING,
+	TRIP_RETURNING
+};
 
 typedef struct {
+	// Where every agent is, put together from the tile it is in and its offset within it after every move
 	Vector2* positions;
+	Tile* tiles;
+	Vector2* offsets;
 	Vector2* directions;
 	float* square_distances;
+
+	// Repulsion from the last steering frame, applied again on the frames in between
+	Vector2* repulsions;
 	byte* infected_periods;
 	byte* time_till_death;
 	bool* simulated;
+	byte* infections;
+
+	// Bulk random numbers, refilled every time they are used
+	float* noise_x;
+	float* noise_y;
+	float* draws;
+
+	// One set of statistics per simulation chunk
+	double* partials;
+
+	byte* trip_states;
+	byte* trip_targets;
+	byte* trip_timers;
+	Vector2* homes;
+
+	// Original index of the agent living in each slot, agents get reordered when removed ones are compacted away
+	uint* ids;
+	uint* order;
+	byte* scratch;
+
+	// One bit per agent, set for agents that stay put under the lockdown
+	uint* stationary;
+
+	// Every per agent array above is a column, laid out, cleared and reordered together
+	Columns columns;
+
+	// Agents in [0, live_count) are still simulated, removed agents are moved to the cold tail behind them. Of the live
+	// ones, agents in [0, moving_count) move and the rest stay put under the lockdown
+	uint count;
+	uint live_count;
+	uint moving_count;
+	uint square_distance_count;
+
+	Arena* arena;
+	Grid* grid;
+
+	// Stationary agents are binned on their own, in slots counted from moving_count, and only again once one of them
+	// has been removed
+	Grid* static_grid;
+	bool static_changed;
+} Population;
+
+typedef struct {
+	uint total_cases;
+	uint active_cases;
+	uint removed;
+
+	// Average position of the agents still being simulated
+	Vector2 center;
+} Statistics;
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Global screen variables
+Vector2 mouse_pos_prev;
+
+// The camera target is relative to the corner of this tile, and so is everything drawn
+Tile g_view_tile;
+
+// Global world variables
+uint g_world_width;
+uint g_world_height;
+
+Vector2 g_hotspots[MAX_HOTSPOTS];
+ushort g_hotspot_count = 0;
+
+// One flow field per hotspot, only rebuilt when the hotspots change
+FlowField* g_flow_fields[MAX_HOTSPOTS];
+bool g_hotspots_changed = false;
+float g_flow_field_cell_size = 100;
+
+Rectangle g_sections[30];
+ushort g_section_count = 0;
+
+// Seed for every counter based random draw in the simulation
+uint g_seed = 1;
+
+// Deterministic runs use a fixed timestep and compensated sums, so a seed reproduces a run bit for bit on any thread count
+bool g_deterministic = false;
+
+uint g_frame = 0;
+uint g_tick = 0;
+
+// Frames advanced as a whole, however many sub-steps each one took. The steering interval counts these, so splitting
+// frames doesn't change how often the repulsion is recomputed
+uint g_steer_frame = 0;
+
+// Frames are split into sub-steps so no agent moves further than this fraction of the spacing between agents at once.
+// The step count is global, the densest cell in the world sets it for everyone
+bool g_substeps = true;
+float g_step_fraction = .5f;
+
+// Keep the grid up to date by moving only the agents that changed cell, instead of sorting everyone again
+bool g_incremental_grid = false;
+
+// Work out the repulsion on a mesh instead of summing over the neighbours, the cost no longer depends on the social
+// distance. Worlds too large for a fine enough mesh keep summing the neighbours
+bool g_mesh_repulsion = false;
+ParticleMesh* g_repulsion_mesh = NULL;
+Grid* g_repulsion_grid = NULL;
+
+// Split neighbour searches by grid occupancy rather than by slot, so threads share out dense crowds evenly
+bool g_balance = false;
+
+// Repulsion is only recomputed every this many frames, and whenever the neighbours are found again for a game tick
+uint g_steer_interval = 1;
+
+// How agents are spread over the world when the simulation starts
+byte g_placement = PLACEMENT_UNIFORM;
+float g_cluster_spread = 350;
+
+// Fraction of agents that stay where they are for the whole run, they are still infected and infect others
+float g_lockdown = 0;
+
+// Agents per 10 000 square units at which crowds come to a standstill, zero keeps everyone at full speed. The density
+// and speed of every grid cell are worked out from its occupancy whenever the grid is built, and the density can be
+// drawn over the world
+float g_crowd_jam_density = 0;
+float* g_crowd_densities = NULL;
+float* g_crowd_speeds = NULL;
+uint g_crowd_cell_count = 0;
+bool g_crowd_draw = false;
+
+// Populations small enough for the distance matrix have no grid, crowding bins them on this one instead
+Grid* g_crowd_grid = NULL;
+
+// Tiered fidelity splits the world into chunks, chunks with no infectious agent nearby only move and bounce their agents
+bool g_tiered = false;
+float g_chunk_size = 500;
+uint g_sleeping_steer_interval = 0;
+
+bool* g_chunks_awake = NULL;
+uint g_chunk_columns = 0;
+uint g_chunk_rows = 0;
+uint g_awake_chunk_count = 0;
+
+// Population parameters
+float g_social_distance = 20;
+float g_social_distance_factor = .5f;
+
+// Hotspot parameters
+float g_hotspot_radius = 150;
+float g_hotspot_attraction = .04f;
+float g_hotspot_visit_chance = .002f;
+
+// Disease parameters
+float g_infection_radius = 42;
+float g_infection_chance = 0.2f;
+float g_infection_duration = 10;
+
+// The chance of catching it from a contact falls off as exp(-falloff * d^2 / radius^2), zero keeps it the same all the way
+// to the infection radius
+float g_infection_falloff = 0;
+
+byte g_infection_kernel = INFECTION_CONTACT;
+
+// Aggregated infection draws against the chance of catching it from any of k infectious neighbours
+float g_infection_table[INFECTION_TABLE_SIZE];
+float g_infection_table_chance = -1;
+
+// Field infection spreads the dose of every infectious agent with a Gaussian falloff of this width, zero takes the width
+// that spreads the dose as far as the infection radius does
+float g_exposure_sigma = 0;
+ParticleMesh* g_exposure = NULL;
+
+// Infection kernels looked up from tables of this many entries instead of being worked out for every pair, zero works
+// them out
+uint g_kernel_table_size = 0;
+KernelTable* g_infection_chances = NULL;
+KernelTable* g_infection_escapes = NULL;
+
+// Seconds spent deciding who catches the disease, so the kernels can be compared on their own
+double g_infection_time = 0;
+
+// The sliders publish parameter blocks here, the simulation copies the newest into the globals above at the start of a
+// game tick, so a parameter never changes partway through one
+ParameterBuffer* g_parameter_buffer = NULL;
+uint g_parameters_version = 0;
+
+// Colors
+Color ui_dark_grey = (Color) { 32, 32, 34, 255 };
+Color ui_light_grey = (Color) { 60, 60, 66, 255 };
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Helper functions
+
+inline float square_root(float number) { 
+	int i; 
+	float x, y; 
+	x = number * 0.5; 
+	y = number; 
+	i = * (int *) &y; 
+	i = 0x5f3759df - (i >> 1); 
+	y = * (float *) &i; 
+	y = y * (1.5 - (x * y * y)); 
+	y = y * (1.5 - (x * y * y)); 
+	return number * y; 
+}
+
+float square_dist(float x1, float y1, float x2, float y2) {
+	return ((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+}
+
+float randf() {
+	return (rand()%10000) / 10000.f;
+}
+
+// Fill both components straight from the bulk generator, then scale them into range
+void rand_vector_array(Rng* rng, Vector2* v, uint size, float min, float max) {
+	float* components = (float*) v;
+	Rng_fill_uniform(rng, components, size * 2);
+
+	for(uint i = 0; i < size * 2; i++)
+		components[i] = (components[i] * (max - min)) + min;
+}
+
+// randomize vector array with angle, a block at a time so the angles and their sines and cosines stay on the stack
+void rand_dir_array(Rng* rng, Vector2* v, uint size) {
+	float angles[256];
+	float sines[256];
+	float cosines[256];
+
+	for(uint start = 0; start < size; start += 256) {
+		uint block = size - start < 256 ? size - start : 256;
+
+		Rng_fill_uniform(rng, angles, block);
+		for(uint i = 0; i < block; i++)
+			angles[i] *= 2 * PI;
+
+		sincos_array(angles, sines, cosines, block);
+
+		for(uint i = 0; i < block; i++) {
+			v[start + i].x = cosines[i];
+			v[start + i].y = sines[i];
+		}
+	}
+}
+
+inline Vector2 Vector_norm(Vector2 v) { 
+	float h = square_root((v.x * v.x) + (v.y * v.y)); 
+	v.x = v.x/h; 
+	v.y = v.y/h; 
+	return v; 
+}
+
+uint stream_seed(uint stream) {
+	return g_seed ^ (stream * 0x9e3779b9);
+}
+
+// Kahan summation, compensation carries the low order bits that were lost by the previous addition
+static inline void kahan_add(float* sum, float* compensation, float value) {
+	float y = value - *compensation;
+	float t = *sum + y;
+	*compensation = (t - *sum) - y;
+	*sum = t;
+}
+
+int min(int x, int y) {
+	return (x < y) * x + (x > y) * y;
+}
+
+int max(int x, int y) {
+	return (x < y) * y + (x > y) * x;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Player functions
+
+// A world position measured from the corner of the tile in view, for things drawn from floats anyway
+Vector2 view_position(Vector2 position) {
+	return (Vector2) { position.x - g_view_tile.x * TILE_SIZE, position.y - g_view_tile.y * TILE_SIZE };
+}
+
+void player_move(Camera2D* camera, float delta) {
+	Vector2 mouse_pos;
+	mouse_pos.x = GetMouseX();
+	mouse_pos.y = GetMouseY();
+
+	if(IsMouseButtonDown(0)) {
+		camera->target.x -= (mouse_pos.x - mouse_pos_prev.x) / camera->zoom;
+		camera->target.y -= (mouse_pos.y - mouse_pos_prev.y) / camera->zoom;
+	}
+
+	camera->target.x = Clamp(camera->target.x, Tile_to_edge(g_view_tile.x, 0, -50), Tile_to_edge(g_view_tile.x, 0, g_world_width + 50));
+	camera->target.y = Clamp(camera->target.y, Tile_to_edge(g_view_tile.y, 0, -50), Tile_to_edge(g_view_tile.y, 0, g_world_height + 50));
+
+	// Panning into the next tile makes that the tile in view
+	Tile_carry(&g_view_tile, &camera->target);
+
+	camera->offset.x = GetScreenWidth() / 2;
+	camera->offset.y = GetScreenHeight()  / 2;
+
+	int zoom_delta = ((-3 * GetMouseWheelMove()));
+	camera->zoom *= 1 - zoom_delta * 4.9715f * delta;
+	// Large worlds can be zoomed out until all of them fits on screen
+	float min_zoom = fminf(.15f, GetScreenHeight() / (float) max(g_world_width, g_world_height));
+	camera->zoom = Clamp(camera->zoom, min_zoom, 1.f);
+
+	mouse_pos_prev = mouse_pos;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Hotspot functions
+
+void hotspots_add(Vector2 position) {
+	if(g_hotspot_count >= MAX_HOTSPOTS)
+		return;
+
+	position.x = Clamp(position.x, 0, g_world_width);
+	position.y = Clamp(position.y, 0, g_world_height);
+
+	g_hotspots[g_hotspot_count++] = position;
+	g_hotspots_changed = true;
+}
+
+// Flow fields are expensive to build, so only rebuild them when a hotspot has been added or moved
+void hotspots_update_flow_fields() {
+	if(!g_hotspots_changed)
+		return;
+
+	for(ushort i = 0; i < g_hotspot_count; i++) {
+		if(g_flow_fields[i] == NULL)
+			g_flow_fields[i] = FlowField_create(g_world_width, g_world_height, g_flow_field_cell_size);
+
+		FlowField_build(g_flow_fields[i], g_hotspots[i], g_sections, g_section_count);
+	}
+
+	g_hotspots_changed = false;
+}
+
+void hotspots_destroy() {
+	for(ushort i = 0; i < MAX_HOTSPOTS; i++) {
+		FlowField_destroy(g_flow_fields[i]);
+		g_flow_fields[i] = NULL;
+	}
+}
+
+void hotspots_draw() {
+	for(ushort i = 0; i < g_hotspot_count; i++) {
+		Vector2 hotspot = view_position(g_hotspots[i]);
+		DrawCircleLines(hotspot.x, hotspot.y, g_hotspot_radius, GOLD);
+		DrawCircle(hotspot.x, hotspot.y, 12, GOLD);
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Chunk functions
+
+void chunks_create() {
+	g_chunk_columns = (uint) ceilf(g_world_width / g_chunk_size);
+	g_chunk_rows = (uint) ceilf(g_world_height / g_chunk_size);
+	g_chunks_awake = (bool*) calloc(g_chunk_columns * g_chunk_rows, sizeof(bool));
+}
+
+void chunks_destroy() {
+	free(g_chunks_awake);
+	g_chunks_awake = NULL;
+}
+
+static inline uint chunk_coordinate(float x, uint size) {
+	int coordinate = (int) (x / g_chunk_size);
+	return coordinate < 0 ? 0 : (coordinate >= (int) size ? size - 1 : (uint) coordinate);
+}
+
+// Every chunk is awake when tiered fidelity is off
+static inline bool chunk_awake(Vector2 position) {
+	if(!g_tiered)
+		return true;
+
+	return g_chunks_awake[chunk_coordinate(position.y, g_chunk_rows) * g_chunk_columns + chunk_coordinate(position.x, g_chunk_columns)];
+}
+
+// Sleeping agents still get a full steering update every so often, staggered by id so it doesn't all land on one frame
+static inline bool agents_full_fidelity(Vector2 position, uint id, uint frame) {
+	if(chunk_awake(position))
+		return true;
+
+	return g_sleeping_steer_interval > 0 && (frame + id) % g_sleeping_steer_interval == 0;
+}
+
+// Wake every chunk that has an infected agent within reach of its border, the rest go to sleep until the next tick.
+// A susceptible agent in a sleeping chunk has no infectious agent within the infection radius, so skipping its
+// infection search never changes who gets infected
+void chunks_wake(Vector2* positions, byte* infected_periods, bool* simulated, uint live_count) {
+	uint chunk_count = g_chunk_columns * g_chunk_rows;
+	memset(g_chunks_awake, 0, sizeof(bool) * chunk_count);
+
+	float reach = g_infection_radius + WAKE_MARGIN;
+
+	for(uint i = 0; i < live_count; i++) {
+		if(infected_periods[i] == 0 || !simulated[i])
+			continue;
+
+		uint column_begin = chunk_coordinate(positions[i].x - reach, g_chunk_columns);
+		uint column_end = chunk_coordinate(positions[i].x + reach, g_chunk_columns);
+		uint row_begin = chunk_coordinate(positions[i].y - reach, g_chunk_rows);
+		uint row_end = chunk_coordinate(positions[i].y + reach, g_chunk_rows);
+
+		for(uint row = row_begin; row <= row_end; row++) {
+			for(uint column = column_begin; column <= column_end; column++)
+				g_chunks_awake[row * g_chunk_columns + column] = true;
+		}
+	}
+
+	g_awake_chunk_count = 0;
+	for(uint chunk = 0; chunk < chunk_count; chunk++)
+		g_awake_chunk_count += g_chunks_awake[chunk];
+}
+
+void chunks_draw() {
+	if(!g_tiered)
+		return;
+
+	for(uint row = 0; row < g_chunk_rows; row++) {
+		for(uint column = 0; column < g_chunk_columns; column++) {
+			if(!g_chunks_awake[row * g_chunk_columns + column])
+				continue;
+
+			Vector2 corner = view_position((Vector2) { column * g_chunk_size, row * g_chunk_size });
+			DrawRectangleLinesEx((Rectangle) { corner.x, corner.y, g_chunk_size, g_chunk_size }, 3, ui_light_grey);
+		}
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Crowd functions
+
+// Fraction of full speed an agent keeps at a density, in agents per 10 000 square units
+static inline float crowd_speed(float density) {
+	if(density <= 0)
+		return 1;
+
+	float speed = 1 - expf(-CROWD_FALLOFF * (g_crowd_jam_density / density - 1));
+	return speed > CROWD_MIN_SPEED ? speed : CROWD_MIN_SPEED;
+}
+
+// The grid crowding reads its cell counts from
+static inline Grid* crowd_grid(Population* population) {
+	return population->grid != NULL ? population->grid : g_crowd_grid;
+}
+
+// Bin every live agent on the crowd's own grid, for populations that have none. Moving agents come first in the slots,
+// so the cells of the ones that move line up with their slots. Returns whether the grid was built again
+bool crowd_bin(Population* population, Workers* workers, bool steer) {
+	if(population->grid != NULL || (g_crowd_jam_density <= 0 && !g_crowd_draw))
+		return false;
+
+	if(g_crowd_grid == NULL || g_crowd_grid->capacity < population->count) {
+		Grid_destroy(g_crowd_grid);
+		g_crowd_grid = Grid_create(g_world_width, g_world_height, GRID_CELL_SIZE, population->count);
+	}
+
+	if(!steer && g_crowd_grid->count == population->live_count)
+		return false;
+
+	Grid_build(g_crowd_grid, workers, population->tiles, population->offsets, population->live_count);
+	return true;
+}
+
+// One pass over the cells, the grid already counted its agents into them. Stationary agents crowd their cell as much
+// as moving ones do
+void crowd_update(Grid* grid, Grid* static_grid) {
+	if(grid == NULL || (g_crowd_jam_density <= 0 && !g_crowd_draw))
+		return;
+
+	if(g_crowd_cell_count != grid->cell_count) {
+		g_crowd_cell_count = grid->cell_count;
+		g_crowd_densities = (float*) realloc(g_crowd_densities, sizeof(float) * g_crowd_cell_count);
+		g_crowd_speeds = (float*) realloc(g_crowd_speeds, sizeof(float) * g_crowd_cell_count);
+	}
+
+	float cell_area = grid->cell_size * grid->cell_size / 10000;
+
+	for(uint cell = 0; cell < grid->cell_count; cell++) {
+		uint count = grid->cell_counts[cell] + (static_grid != NULL ? static_grid->cell_counts[cell] : 0);
+		g_crowd_densities[cell] = count / cell_area;
+		g_crowd_speeds[cell] = g_crowd_jam_density > 0 ? crowd_speed(g_crowd_densities[cell]) : 1;
+	}
+}
+
+void crowd_destroy() {
+	free(g_crowd_densities);
+	free(g_crowd_speeds);
+	g_crowd_densities = NULL;
+	g_crowd_speeds = NULL;
+	g_crowd_cell_count = 0;
+
+	Grid_destroy(g_crowd_grid);
+	g_crowd_grid = NULL;
+}
+
+// Shade every occupied cell by its density, relative to the jam density or to the densest cell when there is none.
+// A folded grid mixes cells from all over the world, so it has nothing sensible to show
+void crowd_draw(Grid* grid) {
+	if(!g_crowd_draw || grid == NULL || grid->folded || g_crowd_cell_count != grid->cell_count)
+		return;
+
+	float scale = g_crowd_jam_density;
+	if(scale <= 0) {
+		for(uint cell = 0; cell < grid->cell_count; cell++)
+			scale = g_crowd_densities[cell] > scale ? g_crowd_densities[cell] : scale;
+	}
+
+	for(uint cell = 0; cell < grid->cell_count; cell++) {
+		if(g_crowd_densities[cell] <= 0)
+			continue;
+
+		float level = fminf(g_crowd_densities[cell] / scale, 1);
+		Color color = { 255, (byte) (200 * (1 - level)), 40, (byte) (40 + 120 * level) };
+
+		uint column = cell % grid->columns;
+		uint row = cell / grid->columns;
+		Vector2 corner = view_position((Vector2) { column * grid->cell_size, row * grid->cell_size });
+		DrawRectangleRec((Rectangle) { corner.x, corner.y, grid->cell_size, grid->cell_size }, color);
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Population functions
+
+// Every per agent array, in the order they are laid out. Agent state is permuted along with the agents, scratch arrays
+// are refilled before they are read and stay where they are
+void Population_register(Population* population) {
+	Columns* columns = &population->columns;
+	columns->count = 0;
+
+	Columns_add(columns, "positions", (void**) &population->positions, sizeof(Vector2), COLUMN_PERMUTED);
+	Columns_add(columns, "tiles", (void**) &population->tiles, sizeof(Tile), COLUMN_PERMUTED);
+	Columns_add(columns, "offsets", (void**) &population->offsets, sizeof(Vector2), COLUMN_PERMUTED);
+	Columns_add(columns, "directions", (void**) &population->directions, sizeof(Vector2), COLUMN_PERMUTED);
+	Columns_add(columns, "repulsions", (void**) &population->repulsions, sizeof(Vector2), COLUMN_PERMUTED);
+	Columns_add(columns, "infected_periods", (void**) &population->infected_periods, sizeof(byte), COLUMN_PERMUTED);
+	Columns_add(columns, "time_till_death", (void**) &population->time_till_death, sizeof(byte), COLUMN_PERMUTED);
+	Columns_add(columns, "simulated", (void**) &population->simulated, sizeof(bool), COLUMN_PERMUTED);
+	Columns_add(columns, "trip_states", (void**) &population->trip_states, sizeof(byte), COLUMN_PERMUTED);
+	Columns_add(columns, "trip_targets", (void**) &population->trip_targets, sizeof(byte), COLUMN_PERMUTED);
+	Columns_add(columns, "trip_timers", (void**) &population->trip_timers, sizeof(byte), COLUMN_PERMUTED);
+	Columns_add(columns, "homes", (void**) &population->homes, sizeof(Vector2), COLUMN_PERMUTED);
+	Columns_add(columns, "infections", (void**) &population->infections, sizeof(byte), 0);
+	Columns_add(columns, "noise_x", (void**) &population->noise_x, sizeof(float), 0);
+	Columns_add(columns, "noise_y", (void**) &population->noise_y, sizeof(float), 0);
+	Columns_add(columns, "draws", (void**) &population->draws, sizeof(float), 0);
+	Columns_add(columns, "ids", (void**) &population->ids, sizeof(uint), COLUMN_PERMUTED);
+	Columns_add(columns, "stationary", (void**) &population->stationary, 0, COLUMN_PERMUTED | COLUMN_BITS);
+	Columns_add(columns, "order", (void**) &population->order, sizeof(uint), 0);
+
+	// Permuting goes through the scratch, so it has to fit the widest column
+	Columns_add(columns, "scratch", (void**) &population->scratch, sizeof(Vector2), 0);
+}
+
+// Carve every population array out of the arena, each one starting on its own cache line
+void Population_layout(Population* population, Arena* arena, uint agent_count) {
+	Arena_reset(arena);
+	population->count = agent_count;
+
+	Columns_layout(&population->columns, arena, agent_count);
+	population->partials = (double*) Arena_push(arena, sizeof(double) * STAT_COUNT * ((agent_count + SIM_CHUNK - 1) / SIM_CHUNK));
+
+	population->square_distance_count = agent_count <= DENSE_AGENT_LIMIT ? agent_count * agent_count : 0;
+	population->square_distances = population->square_distance_count > 0 ? (float*) Arena_push(arena, sizeof(float) * population->square_distance_count) : NULL;
+}
+
+// Bytes Population_layout needs for a number of agents, without touching any of the population's arrays
+size_t Population_measure(Population* population, uint agent_count) {
+	Arena measure = { 0 };
+
+	Columns_measure(&population->columns, &measure, agent_count);
+	Arena_push(&measure, sizeof(double) * STAT_COUNT * ((agent_count + SIM_CHUNK - 1) / SIM_CHUNK));
+
+	if(agent_count <= DENSE_AGENT_LIMIT)
+		Arena_push(&measure, sizeof(float) * agent_count * agent_count);
+
+	return measure.used;
+}
+
+Population* Population_create(uint agent_count) {
+	Population* population = (Population*) malloc(sizeof(Population));
+	Population_register(population);
+
+	// Measure the layout first so the whole population fits in a single allocation
+	population->arena = Arena_create(Population_measure(population, agent_count));
+	Population_layout(population, population->arena, agent_count);
+
+	population->grid = population->square_distances == NULL ? Grid_create(g_world_width, g_world_height, GRID_CELL_SIZE, agent_count) : NULL;
+	population->static_grid = population->grid != NULL && g_lockdown > 0 ? Grid_create(g_world_width, g_world_height, GRID_CELL_SIZE, agent_count) : NULL;
+	population->static_changed = true;
+
+	return population;
+}
+
+// Lay the population out again for a new agent count without going back to the allocator, agents_reset zeroes the
+// columns as it fills them. A count that doesn't fit leaves the population as it was
+bool Population_reset(Population* population, uint agent_count) {
+	if(Population_measure(population, agent_count) > population->arena->capacity)
+		return false;
+
+	Population_layout(population, population->arena, agent_count);
+	return true;
+}
+
+void Population_destroy(Population* population) {
+	if(population == NULL)
+		return;
+
+	Arena_destroy(population->arena);
+	Grid_destroy(population->grid);
+	Grid_destroy(population->static_grid);
+	free(population);
+}
+
+void Population_print_footprint(Population* population) {
+	Arena* arena = population->arena;
+	size_t matrix_bytes = sizeof(float) * population->square_distance_count;
+
+	printf("Population: %u agents, %.2f MB used of a %.2f MB arena (%s)\n", population->count, arena->used / 1048576.f, arena->capacity / 1048576.f, arena->huge_pages ? "huge pages" : "regular pages");
+	printf("    %.1f bytes per agent, %.2f MB distance matrix\n", (arena->used - matrix_bytes) / (float) population->count, matrix_bytes / 1048576.f);
+
+	// Agent state is what every reorder has to move, scratch only takes up room
+	float state_bytes = 0;
+	float scratch_bytes = 0;
+	for(uint i = 0; i < population->columns.count; i++) {
+		Column* column = &population->columns.columns[i];
+		if(column->flags & COLUMN_PERMUTED)
+			state_bytes += Column_agent_bytes(column);
+		else
+			scratch_bytes += Column_agent_bytes(column);
+	}
+
+	printf("    %u columns, %.3f bytes of agent state and %.1f of scratch per agent before padding\n", population->columns.count, state_bytes, scratch_bytes);
+
+	printf("    agent state:");
+	for(uint i = 0; i < population->columns.count; i++) {
+		Column* column = &population->columns.columns[i];
+		if(column->flags & COLUMN_PERMUTED)
+			printf(" %s%s", column->name, column->flags & COLUMN_BITS ? " (bits)" : "");
+	}
+	printf("\n");
+}
+
+// Zero one chunk of every per agent array. Pages land on the node of the core that touches them first, so with pinned
+// workers each one's share of the population ends up in its own node's memory
+void population_touch_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	Population* population = (Population*) data;
+	size_t count = end - begin;
+
+	Columns_clear(&population->columns, begin, end);
+
+	if(population->square_distances != NULL)
+		memset(population->square_distances + (size_t) begin * population->count, 0, sizeof(float) * count * population->count);
+}
+
+// Touch the population in the same chunks the simulation passes use, before anything else writes to it
+void Population_touch(Population* population, Workers* workers) {
+	Workers_run(workers, population_touch_chunk, population, population->count, SIM_CHUNK);
+}
+
+// Check which node a sample of every pinned worker's share of the population ended up on
+void Population_print_locality(Population* population, Workers* workers, Topology* topology) {
+	uint chunk_count = (population->count + SIM_CHUNK - 1) / SIM_CHUNK;
+	uint total_local = 0;
+	uint total_sampled = 0;
+
+	for(uint worker = 0; worker < workers->count; worker++) {
+		uint begin = (uint) ((unsigned long long) chunk_count * worker / workers->count) * SIM_CHUNK;
+		uint end = (uint) ((unsigned long long) chunk_count * (worker + 1) / workers->count) * SIM_CHUNK;
+		end = end < population->count ? end : population->count;
+
+		uint node = Topology_node_of(topology, worker);
+		uint local = 0;
+		uint remote = 0;
+
+		for(uint sample = 0; sample < 16 && begin < end; sample++) {
+			uint i = begin + (uint) ((unsigned long long) (end - begin) * sample / 16);
+			void* addresses[] = { population->positions + i, population->directions + i, population->infected_periods + i, population->ids + i };
+
+			for(uint a = 0; a < sizeof(addresses) / sizeof(addresses[0]); a++) {
+				int page_node = Topology_page_node(addresses[a]);
+				local += page_node == (int) node;
+				remote += page_node >= 0 && page_node != (int) node;
+			}
+		}
+
+		printf("    worker %u on core %u (node %u): %u local, %u remote of the sampled pages\n", worker, topology->cpus[worker % topology->cpu_count], node, local, remote);
+		total_local += local;
+		total_sampled += local + remote;
+	}
+
+	if(total_sampled > 0)
+		printf("    %.1f%% of sampled pages are local to the worker using them\n", 100.f * total_local / total_sampled);
+	else
+		printf("    page placement is not available on this system\n");
+}
+
+// Agents stay put or not for the whole run, decided by their id so it survives every reordering
+static inline bool agents_stationary(uint id) {
+	return g_lockdown > 0 && rng_uniform(stream_seed(STREAM_LOCKDOWN), id, 0, 0) < g_lockdown;
+}
+
+// Stable partition of the live prefix into moving, stationary and removed agents. Removed agents join the cold tail so
+// hot loops can stop at live_count, and passes that only move agents can stop at moving_count. Stationary agents keep
+// their order among themselves, so their grid only has to be built again when one of them is removed
+void agents_compact(Population* population) {
+	uint live_count = population->live_count;
+	bool* simulated = population->simulated;
+	uint* stationary = population->stationary;
+	uint* order = population->order;
+
+	uint moving = 0;
+	for(uint i = 0; i < live_count; i++) {
+		if(simulated[i] && !Columns_bit(stationary, i))
+			order[moving++] = i;
+	}
+
+	uint live = moving;
+	for(uint i = 0; i < live_count; i++) {
+		if(simulated[i] && Columns_bit(stationary, i))
+			order[live++] = i;
+	}
+
+	if(live == live_count && moving == population->moving_count)
+		return;
+
+	population->static_changed |= live - moving != live_count - population->moving_count;
+
+	uint removed = live;
+	for(uint i = 0; i < live_count; i++) {
+		if(!simulated[i])
+			order[removed++] = i;
+	}
+
+	Columns_permute(&population->columns, order, live_count, population->scratch);
+
+	population->live_count = live;
+	population->moving_count = moving;
+}
+
+// Read from the distance matrix when the population is small enough to have one
+static inline float agents_square_dist(float* square_distances, Vector2* positions, uint i, uint j, uint agent_count) {
+	if(square_distances != NULL)
+		return square_distances[i*agent_count + j];
+
+	return square_dist(positions[i].x, positions[i].y, positions[j].x, positions[j].y);
+}
+
+// Only the rows steering is about to recompute the repulsion from are filled in, nothing reads the others this frame
+void agents_find_distances(float* square_distances, Vector2* positions, uint* ids, uint frame, bool steer, uint begin, uint end, uint agent_count) {
+	if(square_distances == NULL)
+		return;
+
+	for(uint i = begin; i < end; i++) {
+		if(!agents_full_fidelity(positions[i], ids[i], frame) || !(steer || !chunk_awake(positions[i])))
+			continue;
+
+		for(uint j = 0; j < agent_count; j++) {
+			square_distances[i*agent_count + j] = square_dist(positions[i].x, positions[i].y, positions[j].x, positions[j].y);
+		}
+	}
+}
+
+// Add the vector opposite the direction of a dot nearby prioritizing closer dots within the social distancing range.
+// compensation is the running error for the deterministic mode, so long sums lose as little as possible to rounding
+static inline void agents_repel(Vector2* repulsion, Vector2* compensation, Vector2* positions, bool* simulated, float dist, uint i, uint j) {
+	if(j == i || dist > g_social_distance * g_social_distance || !simulated[j])
+		return;
+
+	float x = (positions[i].x - positions[j].x) / dist;
+	float y = (positions[i].y - positions[j].y) / dist;
+
+	if(g_deterministic) {
+		kahan_add(&repulsion->x, &compensation->x, x);
+		kahan_add(&repulsion->y, &compensation->y, y);
+	}
+
+	else {
+		repulsion->x += x;
+		repulsion->y += y;
+	}
+}
+
+// Sum the repulsion from every agent within the social distance. Neighbours come from the grid of moving agents and the
+// grid of stationary ones when there are grids, otherwise every agent is checked against the distance matrix
+Vector2 agents_repulsion(Vector2* positions, Tile* tiles, Vector2* offsets, bool* simulated, float* square_distances, Grid* grid, Grid* static_grid, uint static_base, uint i, uint agent_count) {
+	Vector2 repulsion;
+	repulsion.x = 0;
+	repulsion.y = 0;
+
+	Vector2 compensation;
+	compensation.x = 0;
+	compensation.y = 0;
+
+	if(grid == NULL) {
+		for(uint j = 0; j < agent_count; j++)
+			agents_repel(&repulsion, &compensation, positions, simulated, agents_square_dist(square_distances, positions, i, j, agent_count), i, j);
+
+		return repulsion;
+	}
+
+	Grid* grids[2] = { grid, static_grid };
+	uint bases[2] = { 0, static_base };
+
+	for(uint g = 0; g < 2 && grids[g] != NULL; g++) {
+		GridRange range = Grid_neighbourhood(grids[g], tiles[i], offsets[i]);
+
+		for(uint row = range.row_begin; row <= range.row_end; row++) {
+			uint* cell_starts = grids[g]->cell_starts + row * grids[g]->columns;
+
+			for(uint k = cell_starts[range.column_begin]; k < cell_starts[range.column_end + 1]; k++) {
+				uint j = grids[g]->agents[k];
+				if(j == GRID_EMPTY)
+					continue;
+
+				j += bases[g];
+				agents_repel(&repulsion, &compensation, positions, simulated, square_dist(positions[i].x, positions[i].y, positions[j].x, positions[j].y), i, j);
+			}
+		}
+	}
+
+	return repulsion;
+}
+
+// Potential whose gradient is the push agents_repel adds up, (x_i - x_j) / d^2 within the social distance and nothing
+// beyond it
+float repulsion_kernel(float distance, float social_distance) {
+	return distance < social_distance ? logf(distance / social_distance) : 0;
+}
+
+// The mesh's potential is flat within its inner distance, so the push from agents that close is summed directly from a
+// grid with cells that size. Agents further away, which are most of them at large social distances, come from the
+// gradient of the potential. An agent's own share of the density sits right on top of it and pushes it almost nowhere
+void agents_repulse_mesh(ParticleMesh* mesh, Grid* grid, Vector2* repulsions, Vector2* positions, Tile* tiles, Vector2* offsets, bool* simulated, uint* ids, uint frame, uint begin, uint end) {
+	float inner_sqr = mesh->inner * mesh->inner;
+
+	for(uint i = begin; i < end; i++) {
+		if(!agents_full_fidelity(positions[i], ids[i], frame))
+			continue;
+
+		Vector2 repulsion = ParticleMesh_sample_gradient(mesh, positions[i]);
+		Vector2 compensation = { 0 };
+		GridRange range = Grid_neighbourhood(grid, tiles[i], offsets[i]);
+
+		for(uint row = range.row_begin; row <= range.row_end; row++) {
+			uint* cell_starts = grid->cell_starts + row * grid->columns;
+
+			for(uint k = cell_starts[range.column_begin]; k < cell_starts[range.column_end + 1]; k++) {
+				uint j = grid->agents[k];
+				float dist = square_dist(positions[i].x, positions[i].y, positions[j].x, positions[j].y);
+
+				if(dist < inner_sqr)
+					agents_repel(&repulsion, &compensation, positions, simulated, dist, i, j);
+			}
+		}
+
+		repulsions[i] = repulsion;
+	}
+}
+
+// Repulsion changes slowly next to the frame time, so it is only recomputed when recompute is set and the cached one is
+// used in between. slots maps the range onto agents when it runs in grid order, it is NULL for plain slot ranges
+void agents_repulse(Vector2* repulsions, Vector2* positions, Tile* tiles, Vector2* offsets, bool* simulated, float* square_distances, Grid* grid, Grid* static_grid, uint static_base, uint* ids, uint* slots, uint frame, bool recompute, uint begin, uint end, uint agent_count) {
+	for(uint n = begin; n < end; n++) {
+		uint i = slots != NULL ? slots[n] : n;
+
+		if(i == GRID_EMPTY || !agents_full_fidelity(positions[i], ids[i], frame))
+			continue;
+
+		// Sleeping agents only get this far on their own steering frames, and their cache is long out of date by then
+		if(recompute || !chunk_awake(positions[i]))
+			repulsions[i] = agents_repulsion(positions, tiles, offsets, simulated, square_distances, grid, static_grid, static_base, i, agent_count);
+	}
+}
+
+// noise holds a uniform number per agent for each axis, filled in bulk before steering
+void agents_steer(Vector2* directions, Vector2* positions, Tile* tiles, Vector2* offsets, Vector2* repulsions, float* noise_x, float* noise_y, uint* ids, uint frame, uint begin, uint end) {
+	for(uint i = begin; i < end; i++) {
+		if(!agents_full_fidelity(positions[i], ids[i], frame))
+			continue;
+
+		directions[i].x += repulsions[i].x * g_social_distance_factor;
+		directions[i].y += repulsions[i].y * g_social_distance_factor;
+
+		directions[i].x += ((noise_x[i] * 2) - 1.f) / 100.f;
+		directions[i].y += ((noise_y[i] * 2) - 1.f) / 100.f;
+
+		// Clamp the directions as to not result in infinite acceleration
+		directions[i].x = Clamp(directions[i].x, -1, 1);
+		directions[i].y = Clamp(directions[i].y, -1, 1);
+	}
+
+	// Bounce off walls, measured from the tile so a far wall is as sharp as the one at the origin
+	for(uint i = begin; i < end; i++) {
+		float left = -Tile_to_edge(tiles[i].x, offsets[i].x, 0);
+		float right = Tile_to_edge(tiles[i].x, offsets[i].x, g_world_width);
+		float top = -Tile_to_edge(tiles[i].y, offsets[i].y, 0);
+		float bottom = Tile_to_edge(tiles[i].y, offsets[i].y, g_world_height);
+
+		if((left < 10 && directions[i].x < 0) || (right < 10 && directions[i].x > 0)) {
+			directions[i].x *= -1;
+		}
+
+		if((top < 10 && directions[i].y < 0) || (bottom < 10 && directions[i].y > 0)) {
+			directions[i].y *= -1;
+		}
+	}
+}
+
+// Pull travelling agents along their hotspot's flow field, a single lookup per agent rather than any path finding
+void agents_steer_trips(Vector2* directions, Vector2* positions, byte* trip_states, byte* trip_targets, Vector2* homes, uint begin, uint end) {
+	for(uint i = begin; i < end; i++) {
+		Vector2 pull;
+
+		if(trip_states[i] == TRIP_OUTBOUND || trip_states[i] == TRIP_VISITING) {
+			pull = FlowField_sample(g_flow_fields[trip_targets[i]], positions[i]);
+		}
+
+		else if(trip_states[i] == TRIP_RETURNING) {
+			pull = Vector2Normalize(Vector2Subtract(homes[i], positions[i]));
+		}
+
+		else {
+			continue;
+		}
+
+		directions[i].x += pull.x * g_hotspot_attraction;
+		directions[i].y += pull.y * g_hotspot_attraction;
+	}
+}
+
+// Advance every agent's trip once per tick, agents that are removed stop travelling
+void agents_plan_trips(Vector2* positions, bool* simulated, byte* trip_states, byte* trip_targets, byte* trip_timers, Vector2* homes, uint* ids, uint tick, uint begin, uint end) {
+	if(g_hotspot_count == 0)
+		return;
+
+	uint seed = stream_seed(STREAM_TRIPS);
+
+	for(uint i = begin; i < end; i++) {
+		if(!simulated[i]) {
+			trip_states[i] = TRIP_NONE;
+			continue;
+		}
+
+		switch(trip_states[i]) {
+			case TRIP_NONE:
+				if(rng_uniform(seed, ids[i], tick, 0) < g_hotspot_visit_chance) {
+					trip_states[i] = TRIP_OUTBOUND;
+					trip_targets[i] = rng_hash(seed, ids[i], tick, 1) % g_hotspot_count;
+					homes[i] = positions[i];
+				}
+				break;
+
+			case TRIP_OUTBOUND:
+				if(Vector2DistanceSqr(positions[i], g_hotspots[trip_targets[i]]) < g_hotspot_radius * g_hotspot_radius) {
+					trip_states[i] = TRIP_VISITING;
+					trip_timers[i] = 30 + rng_hash(seed, ids[i], tick, 2) % 50;
+				}
+				break;
+
+			case TRIP_VISITING:
+				if(--trip_timers[i] == 0)
+					trip_states[i] = TRIP_RETURNING;
+				break;
+
+			case TRIP_RETURNING:
+				if(Vector2DistanceSqr(positions[i], homes[i]) < 50 * 50)
+					trip_states[i] = TRIP_NONE;
+				break;
+		}
+	}
+}
+
+// Moving the offset rather than the position keeps every step exact, however far the agent is from the origin. In a
+// crowd agents move at the speed of the grid cell they were last binned into
+void agents_move(Vector2* directions, Tile* tiles, Vector2* offsets, Vector2* positions, float* crowd_speeds, uint* cells, uint begin, uint end, float delta) {
+	for(uint i = begin; i < end; i++) {
+		float speed = crowd_speeds != NULL ? 90.f * crowd_speeds[cells[i]] : 90.f;
+		offsets[i].x += directions[i].x * delta * speed;
+		offsets[i].y += directions[i].y * delta * speed; 
+	}
+
+	for(uint i = begin; i < end; i++) {
+		Tile_carry(&tiles[i], &offsets[i]);
+		positions[i] = Tile_position(tiles[i], offsets[i]);
+	}
+}
+
+// Add an "age" to determine how long the agent has been infected, this function runs once every tenth of a second and every tenth of a second has a 10% chance of incrementing the age by one. Meaning on average, the dots are incrementing their age by 1 every second. This is handled this way to distribute the agent's aging as to not result in huge spikes of mass death
+void agents_age(byte* infected_periods, bool* simulated, byte* time_till_death, uint* ids, uint tick, uint begin, uint end) {
+	uint seed = stream_seed(STREAM_AGING);
+
+	for(uint i = begin; i < end; i++) {
+		if(infected_periods[i] > 0 && infected_periods[i] < g_infection_duration) {
+			infected_periods[i] += (rng_uniform(seed, ids[i], tick, 0) < .1f);
+		}
+	}
+	
+	for(uint i = begin; i < end; i++) {
+		simulated[i] = simulated[i] && infected_periods[i] < time_till_death[i];
+	}
+}
+
+// Agents must wait once second before able to spread disease as to prevent agents from infecting others the frame they become infected
+void agents_incubate(byte* infected_periods, uint begin, uint end) {
+	for(uint i = begin; i < end; i++) {
+		if(infected_periods[i] == 1) {
+			infected_periods[i]++;
+		}
+	}
+}
+
+// Fill in 1 - (1 - chance)^k for every neighbour count, only when the infection chance has changed since last time
+void infection_table_update() {
+	if(g_infection_table_chance == g_infection_chance)
+		return;
+
+	float escape = 1;
+	for(uint k = 0; k < INFECTION_TABLE_SIZE; k++) {
+		g_infection_table[k] = 1 - escape;
+		escape *= 1 - g_infection_chance;
+	}
+
+	g_infection_table_chance = g_infection_chance;
+}
+
+// Escaping k contacts one at a time is (1 - chance)^k, so a single draw against this decides the same thing
+static inline float infection_probability(uint contacts) {
+	if(contacts < INFECTION_TABLE_SIZE)
+		return g_infection_table[contacts];
+
+	return 1 - powf(1 - g_infection_chance, contacts);
+}
+
+static inline float infection_falloff(float dist, float chance, float falloff, float infection_radius_sqr) {
+	return chance * expf(-falloff * dist / infection_radius_sqr);
+}
+
+// Chance of catching it from a single infectious agent this far away
+static inline float pair_infection_chance(float dist, float infection_radius_sqr) {
+	if(g_infection_falloff == 0)
+		return g_infection_chance;
+
+	if(g_infection_chances != NULL)
+		return KernelTable_lookup(g_infection_chances, dist);
+
+	return infection_falloff(dist, g_infection_chance, g_infection_falloff, infection_radius_sqr);
+}
+
+// log(1 - chance) for a single infectious agent this far away, escaping several of them adds these up. Aggregated
+// infection only needs it with a falloff, otherwise counting the contacts is enough
+static inline float pair_infection_escape(float dist, float infection_radius_sqr) {
+	if(g_infection_falloff == 0)
+		return 0;
+
+	if(g_infection_escapes != NULL)
+		return KernelTable_lookup(g_infection_escapes, dist);
+
+	return log1pf(-infection_falloff(dist, g_infection_chance, g_infection_falloff, infection_radius_sqr));
+}
+
+// Each susceptible agent looks at the infectious agents around it and decides only its own fate. Every contact gets
+// its own draw from the agent's stream for this tick, so the outcome doesn't depend on the order agents are visited in.
+// The first draw of every stream is precomputed in bulk into draws, most agents never need a second one. Aggregated
+// infection only counts the contacts and makes that first draw against the chance of catching it from any of them.
+// infections has to be cleared beforehand, and slots maps the range onto agents like it does for agents_repulse
+void agents_catch_disease(Vector2* positions, Tile* tiles, Vector2* offsets, float* square_distances, Grid* grid, Grid* static_grid, uint static_base, byte* infected_periods, bool* simulated, byte* infections, float* draws, uint* ids, uint* slots, uint tick, uint begin, uint end, uint agent_count) {
+	float infection_radius_sqr = g_infection_radius * g_infection_radius;
+	uint seed = stream_seed(STREAM_INFECTION);
+
+	for(uint n = begin; n < end; n++) {
+		uint j = slots != NULL ? slots[n] : n;
+
+		if(j == GRID_EMPTY || infected_periods[j] != 0 || !simulated[j] || !chunk_awake(positions[j]))
+			continue;
+
+		uint contacts = 0;
+		float log_escape = 0;
+
+		if(grid == NULL) {
+			for(uint i = 0; i < agent_count && !infections[j]; i++) {
+				if(infected_periods[i] < 2 || !simulated[i])
+					continue;
+
+				float dist = agents_square_dist(square_distances, positions, j, i, agent_count);
+				if(dist >= infection_radius_sqr)
+					continue;
+
+				if(g_infection_kernel == INFECTION_AGGREGATE) {
+					contacts++;
+					log_escape += pair_infection_escape(dist, infection_radius_sqr);
+					continue;
+				}
+
+				float draw = contacts == 0 ? draws[j] : rng_uniform(seed, ids[j], tick, contacts);
+				contacts++;
+				infections[j] = draw < pair_infection_chance(dist, infection_radius_sqr);
+			}
+		}
+
+		else {
+			Grid* grids[2] = { grid, static_grid };
+			uint bases[2] = { 0, static_base };
+
+			for(uint g = 0; g < 2 && grids[g] != NULL && !infections[j]; g++) {
+				GridRange range = Grid_neighbourhood(grids[g], tiles[j], offsets[j]);
+
+				for(uint row = range.row_begin; row <= range.row_end && !infections[j]; row++) {
+					uint* cell_starts = grids[g]->cell_starts + row * grids[g]->columns;
+
+					for(uint k = cell_starts[range.column_begin]; k < cell_starts[range.column_end + 1] && !infections[j]; k++) {
+						uint i = grids[g]->agents[k];
+						if(i == GRID_EMPTY)
+							continue;
+
+						i += bases[g];
+						if(infected_periods[i] < 2 || !simulated[i])
+							continue;
+
+						float dist = square_dist(positions[j].x, positions[j].y, positions[i].x, positions[i].y);
+						if(dist >= infection_radius_sqr)
+							continue;
+
+						if(g_infection_kernel == INFECTION_AGGREGATE) {
+							contacts++;
+							log_escape += pair_infection_escape(dist, infection_radius_sqr);
+							continue;
+						}
+
+						float draw = contacts == 0 ? draws[j] : rng_uniform(seed, ids[j], tick, contacts);
+						contacts++;
+						infections[j] = draw < pair_infection_chance(dist, infection_radius_sqr);
+					}
+				}
+			}
+		}
+
+		if(g_infection_kernel == INFECTION_AGGREGATE && contacts > 0)
+			infections[j] = draws[j] < (g_infection_falloff == 0 ? infection_probability(contacts) : 1 - expf(log_escape));
+	}
+}
+
+// Failed draws before the next success, from an agent's stream. log_escape is log(1 - chance), a chance of zero never
+// succeeds and ends up at the cap
+static inline uint infection_skip(uint seed, uint id, uint tick, uint draw, float log_escape) {
+	float skip = logf(1 - rng_uniform(seed, id, tick, draw)) / log_escape;
+	return skip < 1e9f ? (uint) skip : 1000000000u;
+}
+
+// Several infectious agents may reach the same susceptible one, they all store the same value so relaxed is enough
+static inline void agents_contact(byte* infected_periods, bool* simulated, byte* infections, float dist, float infection_radius_sqr, uint j) {
+	if(infected_periods[j] == 0 && simulated[j] && dist < infection_radius_sqr)
+		__atomic_store_n(&infections[j], 1, __ATOMIC_RELAXED);
+}
+
+// Every pair gets an independent draw with the infection chance, so instead of drawing for each candidate an infectious
+// agent jumps a geometric number of candidates ahead to the next success. Only the candidates it lands on are checked,
+// so the cost follows the number of infections rather than the number of candidates. Candidates are every live agent
+// when there is a distance matrix, or the rows of the grid block around the agent, one contiguous run of slots each.
+// With a falloff the skips still use the full chance, and a candidate they land on only keeps it with its own chance
+// over the full one
+void agents_spread_disease(Vector2* positions, Tile* tiles, Vector2* offsets, float* square_distances, Grid* grid, Grid* static_grid, uint static_base, byte* infected_periods, bool* simulated, byte* infections, uint* ids, uint tick, uint begin, uint end, uint agent_count) {
+	float infection_radius_sqr = g_infection_radius * g_infection_radius;
+	float log_escape = g_infection_chance < 1 ? logf(1 - g_infection_chance) : -INFINITY;
+	uint seed = stream_seed(STREAM_INFECTION);
+
+	for(uint i = begin; i < end; i++) {
+		if(infected_periods[i] < 2 || !simulated[i])
+			continue;
+
+		uint draw = 0;
+		uint skip = infection_skip(seed, ids[i], tick, draw++, log_escape);
+
+		if(grid == NULL) {
+			for(uint j = skip; j < agent_count; j += skip + 1) {
+				float dist = agents_square_dist(square_distances, positions, i, j, agent_count);
+
+				if(g_infection_falloff == 0 || rng_uniform(seed, ids[i], tick, draw++) * g_infection_chance < pair_infection_chance(dist, infection_radius_sqr))
+					agents_contact(infected_periods, simulated, infections, dist, infection_radius_sqr, j);
+
+				skip = infection_skip(seed, ids[i], tick, draw++, log_escape);
+			}
+
+			continue;
+		}
+
+		Grid* grids[2] = { grid, static_grid };
+		uint bases[2] = { 0, static_base };
+
+		for(uint g = 0; g < 2 && grids[g] != NULL; g++) {
+			GridRange range = Grid_neighbourhood(grids[g], tiles[i], offsets[i]);
+
+			for(uint row = range.row_begin; row <= range.row_end; row++) {
+				uint* cell_starts = grids[g]->cell_starts + row * grids[g]->columns;
+				uint k = cell_starts[range.column_begin];
+				uint last = cell_starts[range.column_end + 1];
+
+				// A skip that runs past the end of this row carries on into the next one, and on into the other grid
+				while(skip < last - k) {
+					k += skip;
+					uint j = grids[g]->agents[k++];
+
+					// Landing on empty slack is a draw for a pair that doesn't exist, it is simply dropped
+					if(j != GRID_EMPTY) {
+						j += bases[g];
+						float dist = square_dist(positions[i].x, positions[i].y, positions[j].x, positions[j].y);
+
+						if(g_infection_falloff == 0 || rng_uniform(seed, ids[i], tick, draw++) * g_infection_chance < pair_infection_chance(dist, infection_radius_sqr))
+							agents_contact(infected_periods, simulated, infections, dist, infection_radius_sqr, j);
+					}
+
+					skip = infection_skip(seed, ids[i], tick, draw++, log_escape);
+				}
+
+				skip -= last - k;
+			}
+		}
+	}
+}
+
+// Test up to INFECTION_LANES candidates against infectious agent i without a branch per candidate. Every test is a mask,
+// the draw for a pair comes from the infectious agent's stream keyed by the candidate's id, and the winners are
+// compressed into the front of winners. Lanes past count are masked off, base is added to every candidate's slot.
+// Returns the number of winners
+static inline uint agents_expose_lanes(Vector2* positions, byte* infected_periods, bool* simulated, uint* ids, uint* restrict candidates, uint count, uint base, float* square_distances, uint i, uint seed, uint tick, float infection_radius_sqr, uint agent_count, uint* restrict winners) {
+	uint js[INFECTION_LANES];
+	uint valid[INFECTION_LANES];
+	uint susceptible[INFECTION_LANES];
+	uint keys[INFECTION_LANES];
+	float dist[INFECTION_LANES];
+
+	// Gather the candidates. Masked lanes point at agent i itself, which is never susceptible so they can never win
+	uint any = 0;
+	for(uint lane = 0; lane < INFECTION_LANES; lane++) {
+		valid[lane] = lane < count && candidates[lane < count ? lane : 0] != GRID_EMPTY;
+		js[lane] = valid[lane] ? candidates[lane] + base : i;
+		susceptible[lane] = valid[lane] & (infected_periods[js[lane]] == 0) & simulated[js[lane]];
+		any |= susceptible[lane];
+	}
+
+	// Once a crowd is mostly infected whole blocks have nobody left to catch it, only those pay for a branch
+	if(!any)
+		return 0;
+
+	for(uint lane = 0; lane < INFECTION_LANES; lane++) {
+		dist[lane] = agents_square_dist(square_distances, positions, i, js[lane], agent_count);
+		keys[lane] = ids[js[lane]];
+	}
+
+	// A falloff looks every lane's chance up on its own, masked lanes are at distance zero so they stay in the table
+	float chance[INFECTION_LANES];
+	for(uint lane = 0; lane < INFECTION_LANES; lane++)
+		chance[lane] = g_infection_chance;
+
+	if(g_infection_falloff != 0) {
+		for(uint lane = 0; lane < INFECTION_LANES; lane++)
+			chance[lane] = pair_infection_chance(dist[lane], infection_radius_sqr);
+	}
+
+	// Everything from here on is the same arithmetic in every lane
+	uint hit[INFECTION_LANES];
+	uint h = rng_mix(rng_mix(rng_mix(seed ^ 0x9e3779b9) ^ ids[i]) ^ tick);
+
+	for(uint lane = 0; lane < INFECTION_LANES; lane++) {
+		float draw = (rng_mix(h ^ keys[lane]) >> 8) * (1.f / 16777216.f);
+		hit[lane] = susceptible[lane] & (dist[lane] < infection_radius_sqr) & (draw < chance[lane]);
+	}
+
+	uint winner_count = 0;
+	for(uint lane = 0; lane < INFECTION_LANES; lane++) {
+		winners[winner_count] = js[lane];
+		winner_count += hit[lane];
+	}
+
+	return winner_count;
+}
+
+// Every infectious agent tests its candidates INFECTION_LANES at a time, each pair gets its own draw like the contact
+// kernel. Candidates are every live agent when there is a distance matrix, or the rows of the grid block around the
+// agent. Winners are only written once a block is done, the same value from any thread so relaxed stores are enough
+void agents_spread_vector(Vector2* positions, Tile* tiles, Vector2* offsets, float* square_distances, Grid* grid, Grid* static_grid, uint static_base, byte* infected_periods, bool* simulated, byte* infections, uint* ids, uint tick, uint begin, uint end, uint agent_count) {
+	float infection_radius_sqr = g_infection_radius * g_infection_radius;
+	uint seed = stream_seed(STREAM_INFECTION);
+	uint winners[INFECTION_LANES];
+	uint sequence[INFECTION_LANES];
+
+	for(uint i = begin; i < end; i++) {
+		if(infected_periods[i] < 2 || !simulated[i])
+			continue;
+
+		if(grid == NULL) {
+			for(uint k = 0; k < agent_count; k += INFECTION_LANES) {
+				for(uint lane = 0; lane < INFECTION_LANES; lane++)
+					sequence[lane] = k + lane;
+
+				uint winner_count = agents_expose_lanes(positions, infected_periods, simulated, ids, sequence, agent_count - k, 0, square_distances, i, seed, tick, infection_radius_sqr, agent_count, winners);
+				for(uint w = 0; w < winner_count; w++)
+					__atomic_store_n(&infections[winners[w]], 1, __ATOMIC_RELAXED);
+			}
+
+			continue;
+		}
+
+		Grid* grids[2] = { grid, static_grid };
+		uint bases[2] = { 0, static_base };
+
+		for(uint g = 0; g < 2 && grids[g] != NULL; g++) {
+			GridRange range = Grid_neighbourhood(grids[g], tiles[i], offsets[i]);
+
+			for(uint row = range.row_begin; row <= range.row_end; row++) {
+				uint* cell_starts = grids[g]->cell_starts + row * grids[g]->columns;
+				uint last = cell_starts[range.column_end + 1];
+
+				for(uint k = cell_starts[range.column_begin]; k < last; k += INFECTION_LANES) {
+					uint winner_count = agents_expose_lanes(positions, infected_periods, simulated, ids, grids[g]->agents + k, last - k, bases[g], NULL, i, seed, tick, infection_radius_sqr, agent_count, winners);
+					for(uint w = 0; w < winner_count; w++)
+						__atomic_store_n(&infections[winners[w]], 1, __ATOMIC_RELAXED);
+				}
+			}
+		}
+	}
+}
+
+// A dose of one carries the infection chance, like a single contact does, and doses add up the way contacts do. The
+// field reaches past the infection radius, so unlike the contact kernels it has to skip sleeping chunks itself
+void agents_expose_field(ParticleMesh* exposure, Vector2* positions, byte* infected_periods, bool* simulated, byte* infections, float* draws, uint begin, uint end) {
+	float log_escape = g_infection_chance < 1 ? logf(1 - g_infection_chance) : -INFINITY;
+
+	for(uint j = begin; j < end; j++) {
+		if(infected_periods[j] != 0 || !simulated[j] || !chunk_awake(positions[j]))
+			continue;
+
+		float dose = ParticleMesh_sample(exposure, positions[j]);
+		infections[j] = dose > 0 && draws[j] < 1 - expf(dose * log_escape);
+	}
+}
+
+// Dose falloff for field infection
+float exposure_kernel(float distance, float sigma) {
+	return expf(-distance * distance / (2 * sigma * sigma));
+}
+
+// The field stands in for the contact kernels, so every infectious agent splats as much dose in total as the infection
+// radius weighed by its falloff holds. The default width also gives the dose the same mean square distance from the
+// agent. Returns the width and sets the dose every infectious agent splats
+float exposure_shape(float* dose) {
+	double radius_sqr = (double) g_infection_radius * g_infection_radius;
+	double falloff = g_infection_falloff;
+
+	// Integrals of exp(-falloff d^2 / r^2) and d^2 exp(-falloff d^2 / r^2) over the disc
+	double area = falloff != 0 ? PI * radius_sqr * (1 - exp(-falloff)) / falloff : PI * radius_sqr;
+	double moment = falloff != 0 ? PI * radius_sqr * radius_sqr * (1 - exp(-falloff) * (1 + falloff)) / (falloff * falloff) : PI * radius_sqr * radius_sqr / 2;
+
+	// A Gaussian of width sigma has a mean square distance of 2 sigma^2 and an area of 2 pi sigma^2
+	double sigma = g_exposure_sigma > 0 ? g_exposure_sigma : sqrt(moment / area / 2);
+	*dose = (float) (area / (2 * PI * sigma * sigma));
+	return (float) sigma;
+}
+
+// Infections are decided for everyone before any are applied, so agents only ever read a consistent state
+void agents_infect(byte* infected_periods, byte* time_till_death, byte* infections, uint begin, uint end) {
+	for(uint j = begin; j < end; j++) {
+		if(infections[j]) {
+			infected_periods[j] = 1;
+			time_till_death[j] = (byte) g_infection_duration;
+		}
+	}
+}
+
+// Only the live prefix needs the full treatment, the cold tail is all removed agents. Agents are drawn from their tiles,
+// relative to the tile in view
+void agents_draw(Tile* tiles, Vector2* offsets, byte* infected_periods, bool* simulated, uint live_count, uint agent_count) {
+	Color white_color = {  100 * g_social_distance_factor, 100 * g_social_distance_factor, 100 * g_social_distance_factor, 255};
+
+	Color red_color = { 0 };
+	red_color.r = 50 * g_infection_chance + 50;
+	red_color.a = 255;
+
+	for(uint i = 0; i < live_count; i++) {
+		if(infected_periods[i] == 0) {
+			Vector2 position = Tile_relative(tiles[i], offsets[i], g_view_tile);
+			DrawCircle(position.x, position.y, g_social_distance, white_color);
+		}
+	}
+
+	for(uint i = 0; i < live_count; i++) {
+		if(infected_periods[i] > 0 && simulated[i]) {
+			Vector2 position = Tile_relative(tiles[i], offsets[i], g_view_tile);
+			DrawCircle(position.x, position.y, g_infection_radius, red_color);
+		}
+	}
+
+	for(uint i = 0; i < live_count; i++) {
+		Vector2 position = Tile_relative(tiles[i], offsets[i], g_view_tile);
+
+		if(!simulated[i]) {
+			DrawCircle(position.x, position.y, 7, GRAY);
+		}
+
+		else if(infected_periods[i] > 0) {
+			DrawCircle(position.x, position.y, 7, RED);
+		}
+
+		else {
+			DrawCircle(position.x, position.y, 7, WHITE);
+		}
+	}
+
+	for(uint i = live_count; i < agent_count; i++) {
+		Vector2 position = Tile_relative(tiles[i], offsets[i], g_view_tile);
+		DrawCircle(position.x, position.y, 7, GRAY);
+	}
+}
+
+// Count one chunk of the live prefix, each chunk writes its own slot of partial sums
+void agents_count(Population* population, uint chunk, uint begin, uint end) {
+	double* partials = population->partials + chunk * STAT_COUNT;
+	byte* infected_periods = population->infected_periods;
+	bool* simulated = population->simulated;
+	Vector2* positions = population->positions;
+
+	uint cases = 0;
+	uint active_cases = 0;
+	uint removed = 0;
+	double x = 0;
+	double y = 0;
+
+	for(uint i = begin; i < end; i++) {
+		cases += (infected_periods[i] > 0);
+		active_cases += (infected_periods[i] > 0 && simulated[i]);
+		removed += (!simulated[i]);
+		x += positions[i].x;
+		y += positions[i].y;
+	}
+
+	partials[STAT_CASES] = cases;
+	partials[STAT_ACTIVE_CASES] = active_cases;
+	partials[STAT_REMOVED] = removed;
+	partials[STAT_CENTER_X] = x;
+	partials[STAT_CENTER_Y] = y;
+}
+
+// Every column starts out zeroed, which leaves agents healthy, at home and at rest, then the rest are filled in. Reset
+// chunks are a whole number of words of a bit column, so workers never clear the same one
+void agents_reset_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	Population* population = (Population*) data;
+	Columns_clear(&population->columns, begin, end);
+
+	for(uint i = begin; i < end; i++)
+		population->simulated[i] = 1;
+
+	// Susceptible agents only stay simulated while this is above their infected period of zero
+	for(uint i = begin; i < end; i++)
+		population->time_till_death[i] = (byte) g_infection_duration;
+
+	for(uint i = begin; i < end; i++)
+		population->ids[i] = i;
+
+	for(uint i = begin; i < end; i++)
+		Columns_set_bit(population->stationary, i, agents_stationary(i));
+
+	Rng rng;
+	Rng_seed(&rng, g_seed, chunk + 1);
+	rand_dir_array(&rng, population->directions + begin, end - begin);
+}
+
+// Placement works in world positions, every agent then gets the tile it landed in
+void agents_tile_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	Population* population = (Population*) data;
+
+	for(uint i = begin; i < end; i++)
+		Tile_split(population->positions[i], &population->tiles[i], &population->offsets[i]);
+}
+
+// Resetting is split into fixed chunks over the workers, so the same seed places agents identically on any thread count
+void agents_reset(Population* population, Workers* workers) {
+	Workers_run(workers, agents_reset_chunk, population, population->count, RESET_CHUNK);
+
+	Placement placement = { 0 };
+	placement.mode = g_placement;
+	placement.width = g_world_width;
+	placement.height = g_world_height;
+	placement.hotspots = g_hotspots;
+	placement.hotspot_count = g_hotspot_count;
+	placement.cluster_spread = g_cluster_spread;
+	placement.seed = g_seed;
+	Placement_run(&placement, workers, population->positions, population->count);
+	Workers_run(workers, agents_tile_chunk, population, population->count, RESET_CHUNK);
+
+	population->live_count = population->count;
+	population->moving_count = population->count;
+	population->static_changed = true;
+
+	// Every agent was placed again, nothing binned before still holds
+	Grid_invalidate(population->grid);
+	Grid_invalidate(g_crowd_grid);
+	g_crowd_cell_count = 0;
+
+	// Sort the agents under lockdown behind the moving ones
+	agents_compact(population);
+}
+
+// Randomly infect one member of the population
+void agents_seed_infection(Population* population) {
+	population->infected_periods[0] = 1;
+	population->time_till_death[0] = (byte) g_infection_duration;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+// Simulation functions
+
+typedef struct {
+	Population* population;
+	float delta;
+	uint frame;
+	uint tick;
+
+	// Set on frames that find neighbours and recompute the repulsion
+	bool steer;
+
+	// Grid order for the balanced neighbour passes, NULL when they run over plain slot ranges
+	uint* slots;
+} SimulationJob;
+
+void distances_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_find_distances(population->square_distances, population->positions, population->ids, job->frame, job->steer, begin, end, population->live_count);
+}
+
+void repulse_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_repulse(population->repulsions, population->positions, population->tiles, population->offsets, population->simulated, population->square_distances, population->grid, population->static_grid, population->moving_count, population->ids, job->slots, job->frame, job->steer, begin, end, population->live_count);
+}
+
+void repulse_mesh_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_repulse_mesh(g_repulsion_mesh, g_repulsion_grid, population->repulsions, population->positions, population->tiles, population->offsets, population->simulated, population->ids, job->frame, begin, end);
+}
+
+void steer_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+
+	rng_fill_hashed_uniform(population->noise_x + begin, stream_seed(STREAM_NOISE_X), population->ids + begin, job->frame, end - begin);
+	rng_fill_hashed_uniform(population->noise_y + begin, stream_seed(STREAM_NOISE_Y), population->ids + begin, job->frame, end - begin);
+
+	agents_steer_trips(population->directions, population->positions, population->trip_states, population->trip_targets, population->homes, begin, end);
+	agents_steer(population->directions, population->positions, population->tiles, population->offsets, population->repulsions, population->noise_x, population->noise_y, population->ids, job->frame, begin, end);
+}
+
+void move_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	Grid* grid = crowd_grid(population);
+
+	// A folded cell holds agents from all over the world, so its count says nothing about any one crowd
+	float* crowd_speeds = grid != NULL && !grid->folded && g_crowd_jam_density > 0 ? g_crowd_speeds : NULL;
+	agents_move(population->directions, population->tiles, population->offsets, population->positions, crowd_speeds, grid != NULL ? grid->cells : NULL, begin, end, job->delta);
+}
+
+// Also gets every agent ready for the infection passes, which may visit them in grid order
+void incubate_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+
+	agents_incubate(population->infected_periods, begin, end);
+
+	memset(population->infections + begin, 0, end - begin);
+	rng_fill_hashed_uniform(population->draws + begin, stream_seed(STREAM_INFECTION), population->ids + begin, job->tick, end - begin);
+}
+
+void catch_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_catch_disease(population->positions, population->tiles, population->offsets, population->square_distances, population->grid, population->static_grid, population->moving_count, population->infected_periods, population->simulated, population->infections, population->draws, population->ids, job->slots, job->tick, begin, end, population->live_count);
+}
+
+void spread_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_spread_disease(population->positions, population->tiles, population->offsets, population->square_distances, population->grid, population->static_grid, population->moving_count, population->infected_periods, population->simulated, population->infections, population->ids, job->tick, begin, end, population->live_count);
+}
+
+void vector_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_spread_vector(population->positions, population->tiles, population->offsets, population->square_distances, population->grid, population->static_grid, population->moving_count, population->infected_periods, population->simulated, population->infections, population->ids, job->tick, begin, end, population->live_count);
+}
+
+void field_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* population = job->population;
+	agents_expose_field(g_exposure, population->positions, population->infected_periods, population->simulated, population->infections, population->draws, begin, end);
+}
+
+// Everything after the infections are decided only touches the agent itself, so it shares a single pass
+void tick_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	SimulationJob* job = (SimulationJob*) data;
+	Population* p = job->population;
+
+	agents_infect(p->infected_periods, p->time_till_death, p->infections, begin, end);
+	agents_age(p->infected_periods, p->simulated, p->time_till_death, p->ids, job->tick, begin, end);
+	agents_plan_trips(p->positions, p->simulated, p->trip_states, p->trip_targets, p->trip_timers, p->homes, p->ids, job->tick, begin, end);
+}
+
+void count_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	agents_count((Population*) data, chunk, begin, end);
+}
+
+// Neighbour searches cost more the denser the crowd, so with balancing on they run over ranges of grid cells split by
+// occupancy. Each agent's result never depends on the split, only how evenly the threads share the work
+// The grid only holds moving agents, so a pass over every live agent can't go in grid order once some are stationary
+void simulation_run_neighbours(Population* population, Workers* workers, WorkerTask task, SimulationJob* job, uint count) {
+	if(job->slots != NULL && count == population->moving_count) {
+		Workers_run_ranges(workers, task, job, Grid_partition_slots(population->grid), population->grid->partition_count);
+		return;
+	}
+
+	uint* slots = job->slots;
+	job->slots = NULL;
+	Workers_run(workers, task, job, count, SIM_CHUNK);
+	job->slots = slots;
+}
+
+// The field is only made again when its width changes. Splatting is serial so doses always add up in the same order,
+// it only touches the infectious agents
+void simulation_expose(Population* population, Workers* workers, SimulationJob* job) {
+	float dose;
+	float sigma = exposure_shape(&dose);
+
+	if(g_exposure == NULL || g_exposure->width != sigma) {
+		ParticleMesh_destroy(g_exposure);
+		g_exposure = ParticleMesh_create(g_world_width, g_world_height, sigma / EXPOSURE_NODES_PER_SIGMA, .5f, EXPOSURE_REACH * sigma, exposure_kernel, sigma, MESH_MAX_SIZE);
+	}
+
+	ParticleMesh_clear(g_exposure);
+	for(uint i = 0; i < population->live_count; i++) {
+		if(population->infected_periods[i] >= 2 && population->simulated[i])
+			ParticleMesh_splat(g_exposure, population->positions[i], dose);
+	}
+
+	ParticleMesh_convolve(g_exposure, workers);
+	Workers_run(workers, field_chunk, job, population->live_count, SIM_CHUNK);
+}
+
+// Mesh nodes are spaced by the world alone, so the near field that is summed directly is the same at every social
+// distance. Returns whether enough of an agent's neighbours, spread evenly, are past the near field for the mesh to
+// beat summing every one of them
+bool repulsion_mesh_pays(uint count, float* cell_size) {
+	float extent = g_world_width > g_world_height ? g_world_width : g_world_height;
+	*cell_size = extent / (REPULSION_MESH_SIZE / 2 - 4);
+
+	float near = REPULSION_NEAR_NODES * *cell_size;
+	if(g_social_distance <= near)
+		return false;
+
+	float density = count / ((float) g_world_width * g_world_height);
+	return density * PI * (g_social_distance * g_social_distance - near * near) >= REPULSION_MESH_MIN_FAR;
+}
+
+// The mesh is only made again when the social distance changes, the grid for close agents only with the world. Only
+// steering frames recompute the repulsion, the rest keep the cached one. Where the mesh doesn't pay the neighbours are
+// summed like without it
+void simulation_repulse_mesh(Population* population, Workers* workers, SimulationJob* job) {
+	float cell_size;
+	if(!repulsion_mesh_pays(population->live_count, &cell_size)) {
+		simulation_run_neighbours(population, workers, repulse_chunk, job, population->moving_count);
+		return;
+	}
+
+	if(!job->steer)
+		return;
+
+	if(g_repulsion_mesh == NULL || g_repulsion_mesh->width != g_social_distance) {
+		ParticleMesh_destroy(g_repulsion_mesh);
+		g_repulsion_mesh = ParticleMesh_create(g_world_width, g_world_height, cell_size, REPULSION_NEAR_NODES, g_social_distance, repulsion_kernel, g_social_distance, REPULSION_MESH_SIZE);
+	}
+
+	if(g_repulsion_grid == NULL || g_repulsion_grid->cell_size != g_repulsion_mesh->inner) {
+		Grid_destroy(g_repulsion_grid);
+		g_repulsion_grid = Grid_create(g_world_width, g_world_height, g_repulsion_mesh->inner, population->count);
+	}
+
+	Grid_build(g_repulsion_grid, workers, population->tiles, population->offsets, population->live_count);
+
+	ParticleMesh_clear(g_repulsion_mesh);
+	for(uint i = 0; i < population->live_count; i++) {
+		if(population->simulated[i])
+			ParticleMesh_splat(g_repulsion_mesh, population->positions[i], 1);
+	}
+
+	ParticleMesh_convolve(g_repulsion_mesh, workers);
+	Workers_run(workers, repulse_mesh_chunk, job, population->moving_count, SIM_CHUNK);
+}
+
+// Steer the agents every frame, on game ticks spread the disease, then move everyone. Infections are decided on the same
+// positions the neighbours were found for. Every pass is split into fixed chunks, with a barrier between passes that read
+// what the previous one wrote
+void simulation_frame(Population* population, Workers* workers, float delta, bool tick, bool first_step) {
+	hotspots_update_flow_fields();
+
+	// Game ticks always find the neighbours again, the infection search needs them to be up to date. Otherwise only the
+	// first sub-step of every steering frame does
+	bool steer = tick || g_steer_interval <= 1 || (first_step && g_steer_frame % g_steer_interval == 0);
+
+	Grid* grid = population->grid;
+	SimulationJob job = { population, delta, g_frame, g_tick, steer, NULL };
+	uint live_count = population->live_count;
+	uint moving_count = population->moving_count;
+
+	// Chunks only change fidelity on game ticks, the wake margin covers how far the epidemic can move in between
+	if(g_tiered && (tick || g_frame == 0))
+		chunks_wake(population->positions, population->infected_periods, population->simulated, live_count);
+
+	// Compacting reorders the slots, so the grid can't wait for the next steering frame after that
+	bool binned = grid != NULL && (steer || grid->count != moving_count);
+	if(binned) {
+		if(g_incremental_grid)
+			Grid_update(grid, workers, population->tiles, population->offsets, moving_count);
+		else
+			Grid_build(grid, workers, population->tiles, population->offsets, moving_count);
+	}
+
+	if(population->static_grid != NULL && population->static_changed) {
+		Grid_build(population->static_grid, workers, population->tiles + moving_count, population->offsets + moving_count, live_count - moving_count);
+		population->static_changed = false;
+	}
+
+	binned |= crowd_bin(population, workers, steer);
+	if(binned || g_crowd_cell_count == 0)
+		crowd_update(crowd_grid(population), population->static_grid);
+
+	if(g_balance && grid != NULL) {
+		if(grid->partition_count == 0 || (tick && g_tick % REBALANCE_TICKS == 0))
+			Grid_balance(grid, BALANCE_RANGES);
+
+		job.slots = grid->agents;
+	}
+
+	Workers_run(workers, distances_chunk, &job, live_count, DISTANCE_CHUNK);
+	if(g_mesh_repulsion)
+		simulation_repulse_mesh(population, workers, &job);
+	else
+		simulation_run_neighbours(population, workers, repulse_chunk, &job, moving_count);
+
+	Workers_run(workers, steer_chunk, &job, moving_count, SIM_CHUNK);
+
+	if(tick) {
+		infection_table_update();
+		Workers_run(workers, incubate_chunk, &job, live_count, SIM_CHUNK);
+
+		double infection_start = time_now();
+		if(g_infection_kernel == INFECTION_SKIP)
+			Workers_run(workers, spread_chunk, &job, live_count, SIM_CHUNK);
+		else if(g_infection_kernel == INFECTION_VECTOR)
+			Workers_run(workers, vector_chunk, &job, live_count, SIM_CHUNK);
+		else if(g_infection_kernel == INFECTION_FIELD)
+			simulation_expose(population, workers, &job);
+		else
+			simulation_run_neighbours(population, workers, catch_chunk, &job, live_count);
+
+		g_infection_time += time_now() - infection_start;
+		Workers_run(workers, tick_chunk, &job, live_count, SIM_CHUNK);
+	}
+
+	Workers_run(workers, move_chunk, &job, moving_count, SIM_CHUNK);
+
+	// Once a second move agents that have been removed out of the way of the hot loops
+	if(tick && ++g_tick % 10 == 0)
+		agents_compact(population);
+
+	g_frame++;
+}
+
+// Spacing between agents in the most crowded cell of the last grid build, capped by the social distance where agents are
+// sparse. Without a grid only the social distance is known
+float simulation_densest_spacing(Population* population) {
+	Grid* grid = population->grid;
+	float spacing = g_social_distance;
+
+	if(grid == NULL)
+		return spacing;
+
+	uint crowd = 0;
+	for(uint cell = 0; cell < grid->cell_count; cell++) {
+		crowd = grid->cell_counts[cell] > crowd ? grid->cell_counts[cell] : crowd;
+	}
+
+	float crowd_spacing = crowd > 1 ? grid->cell_size / sqrtf(crowd) : spacing;
+	return crowd_spacing < spacing ? crowd_spacing : spacing;
+}
+
+// The largest steps that keep the fastest possible agent within a fraction of the spacing, so agents can't jump
+// through each other or through the walls at high simulation speeds. Every agent takes the same steps, so a single
+// crowded cell makes the whole world step finely while it lasts
+uint simulation_global_substeps(Population* population, float delta) {
+	if(!g_substeps)
+		return 1;
+
+	float limit = g_step_fraction * simulation_densest_spacing(population);
+	float steps = ceilf(delta * MAX_SPEED / limit);
+
+	return steps < 1 ? 1 : (steps > MAX_SUBSTEPS ? MAX_SUBSTEPS : (uint) steps);
+}
+
+Parameters parameters_current() {
+	Parameters parameters = { 0 };
+	parameters.social_distance = g_social_distance;
+	parameters.social_distance_factor = g_social_distance_factor;
+	parameters.infection_radius = g_infection_radius;
+	parameters.infection_chance = g_infection_chance;
+	parameters.infection_falloff = g_infection_falloff;
+	parameters.infection_duration = g_infection_duration;
+	return parameters;
+}
+
+void parameters_latch() {
+	if(g_parameter_buffer == NULL)
+		return;
+
+	bool fresh;
+	const Parameters* parameters = ParameterBuffer_latch(g_parameter_buffer, &fresh);
+	if(!fresh)
+		return;
+
+	g_social_distance = parameters->social_distance;
+	g_social_distance_factor = parameters->social_distance_factor;
+	g_infection_radius = parameters->infection_radius;
+	g_infection_chance = parameters->infection_chance;
+	g_infection_falloff = parameters->infection_falloff;
+	g_infection_duration = parameters->infection_duration;
+	g_parameters_version = parameters->version;
+}
+
+float repulsion_weight_kernel(float square_distance, const Parameters* parameters) {
+	return 1 / square_distance;
+}
+
+float infection_chance_kernel(float square_distance, const Parameters* parameters) {
+	float radius_sqr = parameters->infection_radius * parameters->infection_radius;
+	return infection_falloff(square_distance, parameters->infection_chance, parameters->infection_falloff, radius_sqr);
+}
+
+// A chance of one would never be escaped, the log is held at a level where the escape rounds to zero anyway
+float infection_escape_kernel(float square_distance, const Parameters* parameters) {
+	return fmaxf(log1pf(-infection_chance_kernel(square_distance, parameters)), -100);
+}
+
+// Tables are built again whenever the parameter block they came from changes, a slider moving or a benchmark setting
+// the globals itself
+void kernel_tables_update() {
+	if(g_kernel_table_size == 0)
+		return;
+
+	if(g_infection_chances == NULL) {
+		g_infection_chances = KernelTable_create(g_kernel_table_size);
+		g_infection_escapes = KernelTable_create(g_kernel_table_size);
+	}
+
+	Parameters parameters = parameters_current();
+	parameters.version = g_parameters_version;
+
+	float radius_sqr = g_infection_radius * g_infection_radius;
+	KernelTable_update(g_infection_chances, infection_chance_kernel, &parameters, radius_sqr, 0);
+	KernelTable_update(g_infection_escapes, infection_escape_kernel, &parameters, radius_sqr, 0);
+}
+
+void kernel_tables_destroy() {
+	KernelTable_destroy(g_infection_chances);
+	KernelTable_destroy(g_infection_escapes);
+	g_infection_chances = NULL;
+	g_infection_escapes = NULL;
+}
+
+// Advance by delta in as many sub-steps as it takes, the game tick lands on the last one. Returns the sub-step count
+uint simulation_advance(Population* population, Workers* workers, float delta, bool tick) {
+	if(tick)
+		parameters_latch();
+
+	kernel_tables_update();
+
+	uint steps = simulation_global_substeps(population, delta);
+
+	for(uint step = 0; step < steps; step++)
+		simulation_frame(population, workers, delta / steps, tick && step == steps - 1, step == 0);
+
+	g_steer_frame++;
+	return steps;
+}
+
+// Everyone in the cold tail has been infected and removed, only the live prefix has to be counted
+Statistics simulation_count(Population* population, Workers* workers) {
+	uint live_count = population->live_count;
+	uint chunk_count = (live_count + SIM_CHUNK - 1) / SIM_CHUNK;
+	uint tail = population->count - live_count;
+
+	Workers_run(workers, count_chunk, population, live_count, SIM_CHUNK);
+
+	double* partials = population->partials;
+	Statistics statistics;
+	statistics.total_cases = (uint) reduce_pairwise(partials + STAT_CASES, chunk_count, STAT_COUNT) + tail;
+	statistics.active_cases = (uint) reduce_pairwise(partials + STAT_ACTIVE_CASES, chunk_count, STAT_COUNT);
+	statistics.removed = (uint) reduce_pairwise(partials + STAT_REMOVED, chunk_count, STAT_COUNT) + tail;
+
+	statistics.center = (Vector2) { 0 };
+	if(live_count > 0) {
+		statistics.center.x = reduce_pairwise(partials + STAT_CENTER_X, chunk_count, STAT_COUNT) / live_count;
+		statistics.center.y = reduce_pairwise(partials + STAT_CENTER_Y, chunk_count, STAT_COUNT) / live_count;
+	}
+
+	return statistics;
+}
+
+// Hash of every position, two runs only match when every agent ended up in exactly the same place
+uint positions_checksum(Population* population) {
+	uint hash = 2166136261u;
+	byte* bytes = (byte*) population->positions;
+
+	for(size_t i = 0; i < sizeof(Vector2) * population->count; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+
+	return hash;
+}
+
+// Restart the epidemic and run it at a fixed timestep, keeping the statistics and the number of awake chunks after every
+// tick when asked for. Returns the time spent simulating, counting is left out
+double simulate(Population* population, Workers* workers, uint ticks, Statistics* curve, uint* awake_chunks) {
+	agents_reset(population, workers);
+	agents_seed_infection(population);
+	g_frame = 0;
+	g_steer_frame = 0;
+	g_tick = 0;
+
+	Workers_reset_busy(workers);
+	double elapsed = 0;
+
+	for(uint tick = 0; tick < ticks; tick++) {
+		double start = time_now();
+
+		for(uint frame = 0; frame < FRAMES_PER_TICK; frame++)
+			simulation_advance(population, workers, FIXED_DELTA, frame == FRAMES_PER_TICK - 1);
+
+		elapsed += time_now() - start;
+
+		if(curve != NULL)
+			curve[tick] = simulation_count(population, workers);
+
+		if(awake_chunks != NULL)
+			awake_chunks[tick] = g_tiered ? g_awake_chunk_count : g_chunk_columns * g_chunk_rows;
+	}
+
+	return elapsed;
+}
+
+// Time each worker has spent running tasks, and how much longer the busiest one took than the average
+void print_busy_time(Workers* workers) {
+	double total = 0;
+	double busiest = 0;
+
+	printf("    busy");
+	for(uint i = 0; i < workers->count; i++) {
+		printf(" %.3f", workers->busy_time[i]);
+		total += workers->busy_time[i];
+		busiest = workers->busy_time[i] > busiest ? workers->busy_time[i] : busiest;
+	}
+
+	printf(" s, imbalance %.2f\n", total > 0 ? busiest * workers->count / total : 1.);
+}
+
+// Run without a window, printing the epidemic curves and a checksum of the final positions
+void run_headless(Population* population, Workers* workers, uint ticks) {
+	Statistics* curve = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	double elapsed = simulate(population, workers, ticks, curve, NULL);
+
+	for(uint tick = 1; tick <= ticks; tick++) {
+		if(tick % 10 == 0 || tick == ticks) {
+			Statistics statistics = curve[tick - 1];
+			printf("tick %u: %u cases, %u active, %u removed, center %.6f %.6f\n", tick, statistics.total_cases, statistics.active_cases, statistics.removed, statistics.center.x, statistics.center.y);
+		}
+	}
+
+	printf("%u ticks of %u agents in %.3f s on %u threads, checksum %08x\n", ticks, population->count, elapsed, workers->count, positions_checksum(population));
+	print_busy_time(workers);
+	free(curve);
+}
+
+// Largest difference between two runs' case and active case curves
+void curves_compare(Statistics* a, Statistics* b, uint ticks, uint* case_gap, uint* active_gap) {
+	*case_gap = 0;
+	*active_gap = 0;
 
-	ushort count;
-	uint square_distance_count;
-} Population;
+	for(uint tick = 0; tick < ticks; tick++) {
+		uint cases = abs((int) a[tick].total_cases - (int) b[tick].total_cases);
+		uint active = abs((int) a[tick].active_cases - (int) b[tick].active_cases);
+		*case_gap = cases > *case_gap ? cases : *case_gap;
+		*active_gap = active > *active_gap ? active : *active_gap;
+	}
+}
 
+// Run the same epidemic at full and at tiered fidelity, then compare how long they took and how far the curves drifted
+void bench_fidelity(Population* population, Workers* workers, uint ticks) {
+	Statistics* full = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	Statistics* tiered = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	uint* awake_chunks = (uint*) malloc(sizeof(uint) * ticks);
+	bool tiered_option = g_tiered;
 
-//----------------------------------------------------------------------------------------------------------------------------------
+	g_tiered = false;
+	double full_time = simulate(population, workers, ticks, full, NULL);
 
+	g_tiered = true;
+	double tiered_time = simulate(population, workers, ticks, tiered, awake_chunks);
 
-// Global screen variables
-Vector2 mouse_pos_prev;
+	g_tiered = tiered_option;
 
-// Global world variables
-ushort g_world_width;
-ushort g_world_height;
+	printf("tick      full cases / active    tiered cases / active    awake chunks\n");
 
-Vector2* g_hotspots;
-ushort g_hotspot_count; 
+	uint chunk_count = g_chunk_columns * g_chunk_rows;
+	double awake_sum = 0;
 
-Rectangle g_sections[30];
-ushort g_section_count = 0;
+	for(uint tick = 0; tick < ticks; tick++) {
+		awake_sum += awake_chunks[tick];
 
-// Population parameters
-float g_social_distance = 20;
-float g_social_distance_factor = .5f;
+		if((tick + 1) % 50 == 0 || tick + 1 == ticks)
+			printf("%-9u %10u / %-10u %11u / %-10u %6u / %u\n", tick + 1, full[tick].total_cases, full[tick].active_cases, tiered[tick].total_cases, tiered[tick].active_cases, awake_chunks[tick], chunk_count);
+	}
 
-// Disease parameters
-float g_infection_radius = 42;
-float g_infection_chance = 0.2f;
-float g_infection_duration = 10;
+	printf("Full fidelity %.3f s, tiered %.3f s (%.2fx), %.1f%% of chunks awake on average\n", full_time, tiered_time, full_time / tiered_time, 100. * awake_sum / ((double) ticks * chunk_count));
+	uint case_gap, active_gap;
+	curves_compare(full, tiered, ticks, &case_gap, &active_gap);
+	printf("Largest gap between the curves: %u cases (%.2f%%), %u active (%.2f%%)\n", case_gap, 100.f * case_gap / population->count, active_gap, 100.f * active_gap / population->count);
 
-// Colors
-Color ui_dark_grey = (Color) { 32, 32, 34, 255 };
-Color ui_light_grey = (Color) { 60, 60, 66, 255 };
+	free(full);
+	free(tiered);
+	free(awake_chunks);
+}
 
+// Run the same epidemic recomputing the repulsion every frame and at a range of lower rates, reporting what each rate
+// saves and how far its curves end up from the every frame run
+void bench_steering(Population* population, Workers* workers, uint ticks) {
+	static const uint intervals[] = { 1, 2, 3, 4, 6, 8, 12 };
+	uint interval_count = sizeof(intervals) / sizeof(intervals[0]);
 
-//----------------------------------------------------------------------------------------------------------------------------------
+	Statistics* reference = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	Statistics* curve = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	uint interval_option = g_steer_interval;
 
+	printf("interval    time      speedup   case gap         active gap       final cases\n");
 
-// Helper functions
+	double reference_time = 0;
+	for(uint n = 0; n < interval_count; n++) {
+		g_steer_interval = intervals[n];
+		Statistics* run = n == 0 ? reference : curve;
+		double elapsed = simulate(population, workers, ticks, run, NULL);
 
-inline float square_root(float number) { 
-	int i; 
-	float x, y; 
-	x = number * 0.5; 
-	y = number; 
-	i = * (int *) &y; 
-	i = 0x5f3759df - (i >> 1); 
-	y = * (float *) &i; 
-	y = y * (1.5 - (x * y * y)); 
-	y = y * (1.5 - (x * y * y)); 
-	return number * y; 
-}
+		if(n == 0)
+			reference_time = elapsed;
 
-float square_dist(float x1, float y1, float x2, float y2) {
-	return ((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
-}
+		uint case_gap, active_gap;
+		curves_compare(reference, run, ticks, &case_gap, &active_gap);
+		printf("%-11u %-9.3f %-9.2f %-6u (%5.2f%%)  %-6u (%5.2f%%)  %u\n", intervals[n], elapsed, reference_time / elapsed, case_gap, 100.f * case_gap / population->count, active_gap, 100.f * active_gap / population->count, run[ticks - 1].total_cases);
+	}
 
-float randf() {
-	return (rand()%10000) / 10000.f;
+	g_steer_interval = interval_option;
+
+	free(reference);
+	free(curve);
 }
 
-void rand_vector_array(Vector2* v, uint size, float min, float max) {
-	for(uint i = 0; i < size; i++) {
-		v[i].x = (randf() * (max - min)) + min;
-		v[i].y = (randf() * (max - min)) + min;
+// Run the same epidemic with neighbour searches split by slot and by grid occupancy, showing how busy each thread was
+void bench_balance(Population* population, Workers* workers, uint ticks) {
+	Statistics* curve = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	bool balance_option = g_balance;
+
+	for(uint balance = 0; balance <= 1; balance++) {
+		g_balance = balance;
+		double elapsed = simulate(population, workers, ticks, curve, NULL);
+
+		printf("%s: %u ticks in %.3f s on %u threads, %u cases\n", balance ? "balanced by occupancy" : "split by slot", ticks, elapsed, workers->count, curve[ticks - 1].total_cases);
+		print_busy_time(workers);
 	}
+
+	g_balance = balance_option;
+	free(curve);
 }
 
-// randomize vector array with angle
-void rand_dir_array(Vector2* v, uint size) {
-	for(uint i = 0; i < size; i++) {
-		float angle = randf() * 2 * PI;
-		v[i].x = cos(angle);
-		v[i].y = sin(angle);
+// Keep a grid up to date over agents drifting across a uniform world, once with full counting sort builds and once
+// incrementally, for a range of crowd densities and speeds in units per frame
+void bench_grid(Workers* workers, uint frames) {
+	static const uint densities[] = { 1, 4, 16, 64 };
+	static const float speeds[] = { .5f, 2, 8, 32 };
+	uint density_count = sizeof(densities) / sizeof(densities[0]);
+	uint speed_count = sizeof(speeds) / sizeof(speeds[0]);
+
+	uint cell_count = (uint) (ceilf(g_world_width / (float) GRID_CELL_SIZE) * ceilf(g_world_height / (float) GRID_CELL_SIZE));
+
+	printf("per cell  speed    rebuild ms   incremental ms   speedup   moved per frame   layouts\n");
+
+	for(uint d = 0; d < density_count; d++) {
+		uint count = cell_count * densities[d];
+		Vector2* positions = (Vector2*) malloc(sizeof(Vector2) * count);
+		Vector2* directions = (Vector2*) malloc(sizeof(Vector2) * count);
+		Tile* tiles = (Tile*) malloc(sizeof(Tile) * count);
+		Vector2* offsets = (Vector2*) malloc(sizeof(Vector2) * count);
+
+		Grid* rebuilt = Grid_create(g_world_width, g_world_height, GRID_CELL_SIZE, count);
+		Grid* incremental = Grid_create(g_world_width, g_world_height, GRID_CELL_SIZE, count);
+
+		for(uint s = 0; s < speed_count; s++) {
+			Rng rng;
+			Rng_seed(&rng, g_seed, d * speed_count + s);
+			rand_vector_array(&rng, positions, count, 0, 1);
+			rand_dir_array(&rng, directions, count);
+
+			for(uint i = 0; i < count; i++) {
+				positions[i].x *= g_world_width;
+				positions[i].y *= g_world_height;
+			}
+
+			double rebuild_time = 0;
+			double incremental_time = 0;
+			incremental->incremental = false;
+			uint layouts = incremental->layouts;
+			ulong moved = 0;
+
+			for(uint frame = 0; frame < frames; frame++) {
+				for(uint i = 0; i < count; i++) {
+					positions[i].x += directions[i].x * speeds[s];
+					positions[i].y += directions[i].y * speeds[s];
+
+					if(positions[i].x < 0 || positions[i].x > g_world_width)
+						directions[i].x *= -1;
+					if(positions[i].y < 0 || positions[i].y > g_world_height)
+						directions[i].y *= -1;
+
+					Tile_split(positions[i], &tiles[i], &offsets[i]);
+				}
+
+				double start = time_now();
+				Grid_build(rebuilt, workers, tiles, offsets, count);
+				rebuild_time += time_now() - start;
+
+				start = time_now();
+				Grid_update(incremental, workers, tiles, offsets, count);
+				incremental_time += time_now() - start;
+				moved += incremental->crossed;
+			}
+
+			printf("%-9u %-8.1f %-12.3f %-16.3f %-9.2f %-17.0f %u\n", densities[d], speeds[s], 1000 * rebuild_time / frames, 1000 * incremental_time / frames, rebuild_time / incremental_time, (double) moved / frames, incremental->layouts - layouts);
+		}
+
+		Grid_destroy(rebuilt);
+		Grid_destroy(incremental);
+		free(positions);
+		free(directions);
+		free(tiles);
+		free(offsets);
 	}
 }
 
-inline Vector2 Vector_norm(Vector2 v) { 
-	float h = square_root((v.x * v.x) + (v.y * v.y)); 
-	v.x = v.x/h; 
-	v.y = v.y/h; 
-	return v; 
-}
+// Run a handful of seeds with every infection kernel. The contact kernels decide infections with the same probabilities,
+// so their average curves should only differ by the spread between seeds. The field spreads the same dose just as far
+// but as a Gaussian rather than a disc, so it only comes close to them
+void bench_infection(Population* population, Workers* workers, uint ticks) {
+	static const uint seeds[] = { 2, 3, 5, 6, 7, 8 };
+	uint seed_count = sizeof(seeds) / sizeof(seeds[0]);
+
+	Statistics* curve = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	byte kernel_option = g_infection_kernel;
+	uint seed_option = g_seed;
+
+	printf("kernel        time      infection  final cases          peak active          peak tick\n");
+
+	for(byte kernel = 0; kernel < INFECTION_KERNEL_COUNT; kernel++) {
+		g_infection_kernel = kernel;
+
+		double elapsed = 0;
+		double cases = 0, cases_sqr = 0;
+		double peak = 0, peak_sqr = 0;
+		double peak_tick = 0;
+		g_infection_time = 0;
+
+		for(uint n = 0; n < seed_count; n++) {
+			g_seed = seeds[n];
+			elapsed += simulate(population, workers, ticks, curve, NULL);
+
+			uint peak_active = 0;
+			uint peak_at = 0;
+			for(uint tick = 0; tick < ticks; tick++) {
+				if(curve[tick].active_cases > peak_active) {
+					peak_active = curve[tick].active_cases;
+					peak_at = tick + 1;
+				}
+			}
 
-int min(int x, int y) {
-	return (x < y) * x + (x > y) * y;
+			cases += curve[ticks - 1].total_cases;
+			cases_sqr += (double) curve[ticks - 1].total_cases * curve[ticks - 1].total_cases;
+			peak += peak_active;
+			peak_sqr += (double) peak_active * peak_active;
+			peak_tick += peak_at;
+		}
+
+		cases /= seed_count;
+		peak /= seed_count;
+		printf("%-13s %-9.3f %-10.3f %-8.0f +- %-8.0f %-8.0f +- %-8.0f %.0f\n", infection_kernel_names[kernel], elapsed, g_infection_time, cases, sqrt(cases_sqr / seed_count - cases * cases), peak, sqrt(peak_sqr / seed_count - peak * peak), peak_tick / seed_count);
+	}
+
+	g_infection_kernel = kernel_option;
+	g_seed = seed_option;
+	free(curve);
 }
 
-int max(int x, int y) {
-	return (x < y) * y + (x > y) * x;
+typedef struct {
+	ReplicaBatch* batch;
+	Parameters parameters;
+	uint frame;
+	uint tick;
+	bool game_tick;
+} ReplicaJob;
+
+void replicas_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	ReplicaJob* job = (ReplicaJob*) data;
+	ReplicaBatch_step(job->batch, &job->parameters, FIXED_DELTA, job->frame, job->tick, job->game_tick, begin, end);
 }
 
+// Step every replica of the batch for ticks game ticks at the fixed timestep, each worker takes whole blocks of lanes
+double simulate_replicas(ReplicaBatch* batch, Workers* workers, uint ticks) {
+	ReplicaJob job = { batch, parameters_current(), 0, 0, false };
+	ReplicaBatch_reset(batch, &job.parameters, g_seed);
 
-//----------------------------------------------------------------------------------------------------------------------------------
+	double start = time_now();
 
+	for(job.tick = 0; job.tick < ticks; job.tick++) {
+		for(uint frame = 0; frame < FRAMES_PER_TICK; frame++) {
+			job.game_tick = frame == FRAMES_PER_TICK - 1;
+			Workers_run(workers, replicas_chunk, &job, batch->block_count, 1);
+			job.frame++;
+		}
+	}
 
-// Player functions
+	return time_now() - start;
+}
 
-void player_move(Camera2D* camera, float delta) {
-	Vector2 mouse_pos;
-	mouse_pos.x = GetMouseX();
-	mouse_pos.y = GetMouseY();
+// Run many small worlds one after the other through the full simulation, then all at once as a batch. Both should end
+// with about the same number of cases, the batch just gets there sooner
+void bench_replicas(Population* population, Workers* workers, uint ticks) {
+	Statistics* curve = (Statistics*) malloc(sizeof(Statistics) * ticks);
+	uint seed_option = g_seed;
+	uint agent_count = population->count;
 
-	if(IsMouseButtonDown(0)) {
-		camera->target.x -= (mouse_pos.x - mouse_pos_prev.x) / camera->zoom;
-		camera->target.y -= (mouse_pos.y - mouse_pos_prev.y) / camera->zoom;
+	printf("%u replicas of %u agents for %u ticks\n", REPLICA_BENCH_COUNT, agent_count, ticks);
+	printf("engine        time      replica ticks/s   final cases\n");
+
+	double elapsed = 0;
+	double cases = 0, cases_sqr = 0;
+
+	for(uint r = 0; r < REPLICA_BENCH_COUNT; r++) {
+		g_seed = seed_option + r;
+		elapsed += simulate(population, workers, ticks, curve, NULL);
+
+		cases += curve[ticks - 1].total_cases;
+		cases_sqr += (double) curve[ticks - 1].total_cases * curve[ticks - 1].total_cases;
 	}
 
-	camera->target.x = Clamp(camera->target.x, -50, g_world_width+50);
-	camera->target.y = Clamp(camera->target.y, -50, g_world_height+50);
+	g_seed = seed_option;
+	cases /= REPLICA_BENCH_COUNT;
+	printf("%-13s %-9.3f %-17.0f %.1f +- %.1f\n", "one by one", elapsed, REPLICA_BENCH_COUNT * ticks / elapsed, cases, sqrt(cases_sqr / REPLICA_BENCH_COUNT - cases * cases));
 
-	camera->offset.x = GetScreenWidth() / 2;
-	camera->offset.y = GetScreenHeight()  / 2;
+	ReplicaBatch* batch = ReplicaBatch_create(REPLICA_BENCH_COUNT, agent_count, g_world_width, g_world_height);
+	elapsed = simulate_replicas(batch, workers, ticks);
 
-	int zoom_delta = ((-3 * GetMouseWheelMove()));
-	camera->zoom *= 1 - zoom_delta * 4.9715f * delta;
-	camera->zoom = Clamp(camera->zoom, .15f, 1.f);
+	cases = 0;
+	cases_sqr = 0;
+	for(uint r = 0; r < REPLICA_BENCH_COUNT; r++) {
+		uint total_cases, active_cases;
+		ReplicaBatch_count(batch, r, &total_cases, &active_cases);
 
-	mouse_pos_prev = mouse_pos;
+		cases += total_cases;
+		cases_sqr += (double) total_cases * total_cases;
+	}
+
+	cases /= REPLICA_BENCH_COUNT;
+	printf("%-13s %-9.3f %-17.0f %.1f +- %.1f\n", "batched", elapsed, REPLICA_BENCH_COUNT * ticks / elapsed, cases, sqrt(cases_sqr / REPLICA_BENCH_COUNT - cases * cases));
+
+	ReplicaBatch_destroy(batch);
+	free(curve);
 }
 
+// Dose from the field against summing the falloff over every infectious agent, for several widths, with every tenth
+// agent infectious. The exact sum is only worked out for a sample of agents and its time scaled up to all of them
+void bench_exposure(Population* population, Workers* workers) {
+	static const float sigmas[] = { 10, 30, 100, 300 };
+	uint sigma_count = sizeof(sigmas) / sizeof(sigmas[0]);
+	uint count = population->count;
 
-//----------------------------------------------------------------------------------------------------------------------------------
+	agents_reset(population, workers);
+	for(uint i = 0; i < count; i++)
+		population->infected_periods[i] = i % 10 == 0 ? 2 : 0;
 
+	uint infectious_count = 0;
+	Vector2* infectious = (Vector2*) malloc(sizeof(Vector2) * count);
+	float* doses = (float*) malloc(sizeof(float) * count);
 
-// Population functions
+	for(uint i = 0; i < count; i += 10)
+		infectious[infectious_count++] = population->positions[i];
 
-Population* Population_create(ushort agent_count) {
-	Population* population = (Population*) malloc(sizeof(Population));
-	population->count = agent_count;
+	uint sample_step = count / 1000 > 0 ? count / 1000 : 1;
 
-	population->positions = (Vector2*) malloc(sizeof(Vector2) * agent_count);
-	population->directions = (Vector2*) malloc(sizeof(Vector2) * agent_count);
-	population->infected_periods = (byte*) malloc(sizeof(byte) * agent_count);
-	population->time_till_death = (byte*) malloc(sizeof(byte) * agent_count);
-	population->simulated = (bool*) malloc(sizeof(bool) * agent_count);
+	printf("%u agents, %u infectious\n", count, infectious_count);
+	printf("sigma     grid      field ms   exact ms   mean dose   mean error   max error\n");
 
+	for(uint n = 0; n < sigma_count; n++) {
+		float sigma = sigmas[n];
+		ParticleMesh* field = ParticleMesh_create(g_world_width, g_world_height, sigma / EXPOSURE_NODES_PER_SIGMA, .5f, EXPOSURE_REACH * sigma, exposure_kernel, sigma, MESH_MAX_SIZE);
 
-	uint n = (uint) (agent_count-1);
-	n = n*n*2;
-	population->square_distance_count = n;
-	population->square_distances = (float*) malloc(sizeof(float) * n);
+		double start = time_now();
+		ParticleMesh_clear(field);
+		for(uint i = 0; i < infectious_count; i++)
+			ParticleMesh_splat(field, infectious[i], 1);
 
-	return population;
-}
+		ParticleMesh_convolve(field, workers);
+		for(uint j = 0; j < count; j++)
+			doses[j] = ParticleMesh_sample(field, population->positions[j]);
 
-void Population_destroy(Population* population) {
-	if(population->positions != NULL)
-		free(population->positions);
+		double field_time = time_now() - start;
 
-	if(population->directions != NULL)
-		free(population->directions);
+		double dose = 0, error = 0, max_error = 0;
+		uint samples = 0;
 
-	if(population->square_distances != NULL)
-		free(population->square_distances);
+		start = time_now();
+		for(uint j = 1; j < count; j += sample_step) {
+			double exact = 0;
+			for(uint i = 0; i < infectious_count; i++) {
+				float dist_sqr = Vector2DistanceSqr(population->positions[j], infectious[i]);
+				exact += expf(-dist_sqr / (2 * sigma * sigma));
+			}
+
+			double difference = fabs(doses[j] - exact);
+			dose += exact;
+			error += difference;
+			max_error = difference > max_error ? difference : max_error;
+			samples++;
+		}
+
+		double exact_time = (time_now() - start) * count / samples;
+		printf("%-9.0f %-9u %-10.2f %-10.2f %-11.4f %-12.4f %.4f\n", sigma, field->size, field_time * 1000, exact_time * 1000, dose / samples, error / samples, max_error);
 
-	if(population->infected_periods != NULL)
-		free(population->infected_periods);
+		ParticleMesh_destroy(field);
+	}
 
-	if(population != NULL)
-		free(population);
+	free(infectious);
+	free(doses);
 }
 
-void agents_find_distances(float* square_distances, Vector2* positions, ushort agent_count) {
-	for(ushort i = 0; i < agent_count; i++) {
-		for(ushort j = 0; j < agent_count; j++) {
-			square_distances[i*agent_count + j] = square_dist(positions[i].x, positions[i].y, positions[j].x, positions[j].y);
-		}
+// One row of the repulsion bench, at the current social distance over the current world. The mesh column shows exact
+// where the mesh doesn't pay and the neighbours are summed instead
+void bench_repulsion_row(Population* population, Workers* workers, Vector2* exact) {
+	uint count = population->count;
+	kernel_tables_update();
+
+	// Without a grid the exact sum checks every pair, the distance matrix isn't filled in here
+	double start = time_now();
+	for(uint i = 0; i < count; i++)
+		exact[i] = agents_repulsion(population->positions, population->tiles, population->offsets, population->simulated, NULL, population->grid, NULL, 0, i, count);
+
+	double exact_time = time_now() - start;
+
+	ParticleMesh_destroy(g_repulsion_mesh);
+	g_repulsion_mesh = NULL;
+	Grid_destroy(g_repulsion_grid);
+	g_repulsion_grid = NULL;
+
+	// Where the mesh gives way to the neighbour sum, a population without a grid reads the distance matrix
+	SimulationJob job = { population, 0, 0, 0, true, NULL };
+	Workers_run(workers, distances_chunk, &job, count, DISTANCE_CHUNK);
+
+	start = time_now();
+	simulation_repulse_mesh(population, workers, &job);
+	double mesh_time = time_now() - start;
+
+	double difference = 0, magnitude = 0;
+	uint neighbours = 0;
+	for(uint i = 0; i < count; i++) {
+		Vector2 mesh = population->repulsions[i];
+		difference += (mesh.x - exact[i].x) * (mesh.x - exact[i].x) + (mesh.y - exact[i].y) * (mesh.y - exact[i].y);
+		magnitude += exact[i].x * exact[i].x + exact[i].y * exact[i].y;
+	}
+
+	// Average count of agents within the social distance, from a sample
+	for(uint i = 0; i < count; i += count / 100 + 1) {
+		for(uint j = 0; j < count; j++)
+			neighbours += j != i && Vector2DistanceSqr(population->positions[i], population->positions[j]) <= g_social_distance * g_social_distance;
 	}
+
+	char mesh_size[16];
+	if(g_repulsion_mesh == NULL)
+		sprintf(mesh_size, "exact");
+	else
+		sprintf(mesh_size, "%u", g_repulsion_mesh->size);
+
+	printf("%-9.0f %-9u %-9s %-10.2f %-10.2f %-12.1f %.4f\n", g_social_distance, g_world_width, mesh_size, exact_time * 1000, mesh_time * 1000, (double) neighbours / ((count + count / 100) / (count / 100 + 1)), magnitude > 0 ? sqrt(difference / magnitude) : 0);
 }
 
-void agents_steer(Vector2* directions, Vector2* positions, bool* simulated, float* square_distances, ushort agent_count) {
-	for(ushort i = 0; i < agent_count; i++) {
-		Vector2 repulsion;
-		repulsion.x = 0;
-		repulsion.y = 0;
+// Repulsion from the mesh against the exact sum over the neighbours, for several social distances. The error is the
+// root mean square of the difference over the root mean square of the exact repulsion. The last row spreads the same
+// agents over a huge world, where the mesh has to give way to the neighbour sum
+void bench_repulsion(Population* population, Workers* workers) {
+	static const float distances[] = { 20, 60, 120 };
+	uint distance_count = sizeof(distances) / sizeof(distances[0]);
+	uint count = population->count;
+	float social_distance_option = g_social_distance;
 
-		// Add the vector opposite the direction of dots nearby prioritizing closer dots within the social distancing range
-		for(ushort j = 0; j < agent_count; j++) {
-			float dist = square_distances[i*agent_count + j];
+	agents_reset(population, workers);
+	if(population->grid != NULL)
+		Grid_build(population->grid, workers, population->tiles, population->offsets, count);
 
-			if(j == i || dist > g_social_distance * g_social_distance || !simulated[j])
-				continue;
+	Vector2* exact = (Vector2*) malloc(sizeof(Vector2) * count);
 
-			repulsion.x += (positions[i].x - positions[j].x) / dist;
-			repulsion.y += (positions[i].y - positions[j].y) / dist;
-		}
+	printf("%u agents\n", count);
+	printf("distance  world     mesh      exact ms   mesh ms    neighbours   error\n");
+
+	for(uint n = 0; n < distance_count; n++) {
+		g_social_distance = distances[n];
+		bench_repulsion_row(population, workers, exact);
+	}
 
-		directions[i].x += repulsion.x * g_social_distance_factor;
-		directions[i].y += repulsion.y * g_social_distance_factor;
+	// The grid is made for the world it covers, so the large world gets one of its own
+	uint world_width = g_world_width;
+	uint world_height = g_world_height;
+	Grid* grid = population->grid;
 
-		directions[i].x += ((randf() * 2) - 1.f) / 100.f;
-		directions[i].y += ((randf() * 2) - 1.f) / 100.f;
+	g_world_width = BENCH_LARGE_WORLD;
+	g_world_height = BENCH_LARGE_WORLD;
+	g_social_distance = distances[distance_count - 1];
+	population->grid = grid != NULL ? Grid_create(g_world_width, g_world_height, GRID_CELL_SIZE, count) : NULL;
 
-		// Clamp the directions as to not result in infinite acceleration
-		directions[i].x = Clamp(directions[i].x, -1, 1);
-		directions[i].y = Clamp(directions[i].y, -1, 1);
+	agents_reset(population, workers);
+	if(population->grid != NULL)
+		Grid_build(population->grid, workers, population->tiles, population->offsets, count);
+
+	bench_repulsion_row(population, workers, exact);
+
+	Grid_destroy(population->grid);
+	population->grid = grid;
+	g_world_width = world_width;
+	g_world_height = world_height;
+
+	ParticleMesh_destroy(g_repulsion_mesh);
+	g_repulsion_mesh = NULL;
+	Grid_destroy(g_repulsion_grid);
+	g_repulsion_grid = NULL;
+
+	g_social_distance = social_distance_option;
+	free(exact);
+}
+
+void bench_reset(Population* population, Workers* workers) {
+	double start = time_now();
+	agents_reset(population, workers);
+	double elapsed = time_now() - start;
+
+	printf("Reset %u agents with %s placement in %.3f s on %u threads\n", population->count, placement_names[g_placement], elapsed, workers->count);
+}
+
+// Time the exact kernel and the table over random squared distances within its range, closer than the floor both
+// divide it out
+double kernel_time(KernelTable* table, uint kernel, const Parameters* parameters, float* distances, uint count, bool lookup) {
+	float radius_sqr = parameters->infection_radius * parameters->infection_radius;
+	volatile float sink = 0;
+	float sum = 0;
+
+	double start = time_now();
+
+	if(lookup) {
+		for(uint i = 0; i < count; i++)
+			sum += KernelTable_lookup(table, distances[i]);
 	}
 
-	// Bounce off walls
-	for(ushort i = 0; i < agent_count; i++) {
-			
-		if((positions[i].x < 10 && directions[i].x < 0) || (positions[i].x > g_world_width - 10 && directions[i].x > 0)) {
-			directions[i].x *= -1;
-		}
+	else if(kernel == 0) {
+		for(uint i = 0; i < count; i++)
+			sum += 1 / distances[i];
+	}
 
-		if((positions[i].y < 10 && directions[i].y < 0) || (positions[i].y > g_world_height - 10 && directions[i].y > 0)) {
-			directions[i].y *= -1;
-		}
+	else if(kernel == 1) {
+		for(uint i = 0; i < count; i++)
+			sum += infection_falloff(distances[i], parameters->infection_chance, parameters->infection_falloff, radius_sqr);
 	}
-}
 
-void agents_move(Vector2* directions, Vector2* positions, ushort agent_count, float delta) {
-	for(ushort i = 0; i < agent_count; i++) {
-		positions[i].x += directions[i].x * delta * 90.f;
-		positions[i].y += directions[i].y * delta * 90.f; 
+	else {
+		for(uint i = 0; i < count; i++)
+			sum += log1pf(-infection_falloff(distances[i], parameters->infection_chance, parameters->infection_falloff, radius_sqr));
 	}
+
+	sink = sum;
+	(void) sink;
+	return time_now() - start;
 }
 
-// Add an "age" to determine how long the agent has been infected, this function runs once every tenth of a second and every tenth of a second has a 10% chance of incrementing the age by one. Meaning on average, the dots are incrementing their age by 1 every second. This is handled this way to distribute the agent's aging as to not result in huge spikes of mass death
-void agents_age(byte* infected_periods, bool* simulated, byte* time_till_death, uint agent_count) {
-	for(ushort i = 0; i < agent_count; i++) {
-		if(infected_periods[i] > 0 && infected_periods[i] < g_infection_duration) {
-			infected_periods[i] += (rand()%10==1);
+// Build every kernel table at a few sizes and report how far it strays from the kernel and what a lookup costs. The
+// infection tables use a falloff of one when none is set, a flat chance is tabled exactly. The simulation always
+// divides the repulsion weight out, it is only tabled here to show how far a table of it would stray
+void bench_kernels() {
+	static const uint sizes[] = { 256, 1024, 4096, 16384 };
+	static const char* names[] = { "repulsion", "chance", "escape" };
+	static const KernelFunction kernels[] = { repulsion_weight_kernel, infection_chance_kernel, infection_escape_kernel };
+	uint size_count = sizeof(sizes) / sizeof(sizes[0]);
+	uint sample_count = 1 << 20;
+
+	Parameters parameters = parameters_current();
+	parameters.infection_falloff = parameters.infection_falloff > 0 ? parameters.infection_falloff : 1;
+
+	float radius_sqr = parameters.infection_radius * parameters.infection_radius;
+	float ranges[] = { parameters.social_distance * parameters.social_distance, radius_sqr, radius_sqr };
+	float floors[] = { BENCH_REPULSION_FLOOR * BENCH_REPULSION_FLOOR, 0, 0 };
+
+	float* distances = (float*) malloc(sizeof(float) * sample_count);
+	Rng rng;
+	Rng_seed(&rng, g_seed, 0);
+
+	printf("kernel      entries   max error    max relative   exact ns   table ns\n");
+
+	for(uint k = 0; k < 3; k++) {
+		for(uint n = 0; n < size_count; n++) {
+			KernelTable* table = KernelTable_create(sizes[n]);
+			KernelTable_update(table, kernels[k], &parameters, ranges[k], floors[k]);
+
+			Rng_fill_uniform(&rng, distances, sample_count);
+			for(uint i = 0; i < sample_count; i++)
+				distances[i] = table->floor + distances[i] * (ranges[k] - table->floor);
+
+			double exact_time = kernel_time(table, k, &parameters, distances, sample_count, false);
+			double table_time = kernel_time(table, k, &parameters, distances, sample_count, true);
+
+			printf("%-11s %-9u %-12.3g %-14.3g %-10.2f %.2f\n", names[k], sizes[n], table->max_error, table->max_relative_error, exact_time * 1e9 / sample_count, table_time * 1e9 / sample_count);
+			KernelTable_destroy(table);
 		}
 	}
-	
-	for(ushort i = 0; i < agent_count; i++) {
-		simulated[i] *= (infected_periods[i] < time_till_death[i]);
-	}
+
+	free(distances);
 }
 
-void agents_spread_disease(Vector2* positions, float* square_distances, byte* infected_periods, bool* simulated, byte* time_till_death, ushort agent_count) {
-	// Agents must wait once second before able to spread disease as to prevent agents from infecting others the frame they become infected
-	for(ushort i = 0; i < agent_count; i++) {
-		if(infected_periods[i] == 1) {
-			infected_periods[i]++;
+void print_usage() {
+	printf("usage: simulator [options]\n");
+	printf("    -n, --agents <count>       number of agents (default 800)\n");
+	printf("    -t, --threads <count>      worker threads, 0 for one per core (default 0)\n");
+	printf("    -s, --seed <seed>          random seed (default 1)\n");
+	printf("    -p, --placement <mode>     uniform, clustered or poisson\n");
+	printf("    -w, --world <units>        width and height of the world (default 4000)\n");
+	printf("    -d, --deterministic        fixed timestep, identical results on any thread count\n");
+	printf("    -k, --steer-interval <n>   recompute the repulsion every n frames (default 1)\n");
+	printf("    -i, --infection <kernel>   contact, aggregate, skip, vector or field\n");
+	printf("    --exposure-sigma <units>   width of the dose falloff for field infection, 0 matches the infection radius (default 0)\n");
+	printf("    --infection-falloff <k>    infection chance falls off as exp(-k d^2 / r^2) within the radius (default 0)\n");
+	printf("    --kernel-table <entries>   look infection kernels up in tables of this size, 0 works them out (default 0)\n");
+	printf("    -b, --balance              split neighbour searches by grid occupancy\n");
+	printf("    --pin                      pin workers to cores and place their share of agents on their node\n");
+	printf("    --no-substeps              move a whole frame at once, instead of the steps the densest cell needs\n");
+	printf("    --mesh-repulsion           work out the repulsion on a mesh where it beats summing the neighbours\n");
+	printf("    --incremental-grid         only move agents that changed grid cell instead of rebuilding the grid\n");
+	printf("    --lockdown <fraction>      fraction of agents that stay where they are (default 0)\n");
+	printf("    --crowd-jam <density>      agents per 10000 square units where crowds stand still, 0 never (default 0)\n");
+	printf("    --tiered                   only fully simulate chunks near an infection\n");
+	printf("    --sleep-steer <frames>     steer agents in sleeping chunks every this many frames, 0 never (default 0)\n");
+	printf("    --run <ticks>              simulate without a window, print the curves and exit\n");
+	printf("    --bench-reset              time resetting the population and exit\n");
+	printf("    --bench-exposure           compare field doses against exact sums and exit\n");
+	printf("    --bench-repulsion          compare mesh repulsion against exact sums and exit\n");
+	printf("    --bench-kernels            compare kernel tables against the kernels and exit\n");
+	printf("    --bench-fidelity <ticks>   compare tiered and full fidelity and exit\n");
+	printf("    --bench-steering <ticks>   compare steering intervals and exit\n");
+	printf("    --bench-infection <ticks>  compare the infection kernels over several seeds and exit\n");
+	printf("    --bench-balance <ticks>    compare splitting work by slot and by occupancy and exit\n");
+	printf("    --bench-grid <frames>      compare rebuilding and incrementally updating the grid and exit\n");
+	printf("    --bench-replicas <ticks>   compare running many small worlds one by one and as a batch and exit\n");
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------------------
+
+
+int main(int argc, char** argv) {
+	uint agent_count_option = 800;
+	uint world_size_option = 4000;
+	uint thread_count = 0;
+	bool run_bench_reset = false;
+	bool run_bench_exposure = false;
+	bool run_bench_kernels = false;
+	bool run_bench_repulsion = false;
+	uint run_ticks = 0;
+	uint bench_fidelity_ticks = 0;
+	uint bench_steering_ticks = 0;
+	uint bench_infection_ticks = 0;
+	uint bench_balance_ticks = 0;
+	uint bench_grid_frames = 0;
+	uint bench_replicas_ticks = 0;
+	bool pin = false;
+
+	for(int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+
+		if((!strcmp(argv[i], "-n") || !strcmp(argv[i], "--agents")) && has_value) {
+			agent_count_option = strtoul(argv[++i], NULL, 10);
 		}
-	}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		if(infected_periods[i] > 0 && simulated[i]) {
-			for(ushort j = 0; j < agent_count; j++) {
-				if(infected_periods[j] == 0 && simulated[i]) {
-					float dist = square_distances[i*agent_count + j];
+		else if((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads")) && has_value) {
+			thread_count = strtoul(argv[++i], NULL, 10);
+		}
 
-					infected_periods[j] = randf() <= g_infection_chance && dist < (g_infection_radius * g_infection_radius);
-					time_till_death[j] = (byte) g_infection_duration;
-				}
+		else if((!strcmp(argv[i], "-s") || !strcmp(argv[i], "--seed")) && has_value) {
+			g_seed = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if((!strcmp(argv[i], "-p") || !strcmp(argv[i], "--placement")) && has_value) {
+			i++;
+			for(byte mode = 0; mode < PLACEMENT_MODE_COUNT; mode++) {
+				if(!strcmp(argv[i], placement_names[mode]))
+					g_placement = mode;
 			}
 		}
-	}
-}
 
-void agents_draw(Vector2* positions, byte* infected_periods, bool* simulated, ushort agent_count) {
-	Color white_color = {  100 * g_social_distance_factor, 100 * g_social_distance_factor, 100 * g_social_distance_factor, 255};
+		else if((!strcmp(argv[i], "-w") || !strcmp(argv[i], "--world")) && has_value) {
+			world_size_option = strtoul(argv[++i], NULL, 10);
+		}
 
-	Color red_color = { 0 };
-	red_color.r = 50 * g_infection_chance + 50;
-	red_color.a = 255;
+		else if(!strcmp(argv[i], "-d") || !strcmp(argv[i], "--deterministic")) {
+			g_deterministic = true;
+		}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		if(infected_periods[i] == 0) {
-			DrawCircle(positions[i].x, positions[i].y, g_social_distance, white_color);
+		else if((!strcmp(argv[i], "-k") || !strcmp(argv[i], "--steer-interval")) && has_value) {
+			g_steer_interval = strtoul(argv[++i], NULL, 10);
 		}
-	}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		if(infected_periods[i] > 0 && simulated[i]) {
-			DrawCircle(positions[i].x, positions[i].y, g_infection_radius, red_color);
+		else if((!strcmp(argv[i], "-i") || !strcmp(argv[i], "--infection")) && has_value) {
+			i++;
+			for(byte kernel = 0; kernel < INFECTION_KERNEL_COUNT; kernel++) {
+				if(!strcmp(argv[i], infection_kernel_names[kernel]))
+					g_infection_kernel = kernel;
+			}
 		}
-	}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		if(!simulated[i]) {
-			DrawCircle(positions[i].x, positions[i].y, 7, GRAY);
+		else if(!strcmp(argv[i], "--exposure-sigma") && has_value) {
+			g_exposure_sigma = strtof(argv[++i], NULL);
 		}
 
-		else if(infected_periods[i] > 0) {
-			DrawCircle(positions[i].x, positions[i].y, 7, RED);
+		else if(!strcmp(argv[i], "--infection-falloff") && has_value) {
+			g_infection_falloff = strtof(argv[++i], NULL);
 		}
 
-		else {
-			DrawCircle(positions[i].x, positions[i].y, 7, WHITE);
+		else if(!strcmp(argv[i], "--kernel-table") && has_value) {
+			g_kernel_table_size = strtoul(argv[++i], NULL, 10);
 		}
-	}
-}
 
-ushort agents_get_active_cases(byte* infected_periods, bool* simulated, uint agent_count) {
-	ushort res = 0;
+		else if(!strcmp(argv[i], "-b") || !strcmp(argv[i], "--balance")) {
+			g_balance = true;
+		}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		res += (infected_periods[i] > 0 && simulated[i]);
-	}
-	
-	return res;
-}
+		else if(!strcmp(argv[i], "--pin")) {
+			pin = true;
+		}
 
-ushort agents_get_cases(byte* infected_periods, uint agent_count) {
-	ushort res = 0;
+		else if(!strcmp(argv[i], "--no-substeps")) {
+			g_substeps = false;
+		}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		res += (infected_periods[i] > 0);
-	}
-	
-	return res;
-}
+		else if(!strcmp(argv[i], "--mesh-repulsion")) {
+			g_mesh_repulsion = true;
+		}
+
+		else if(!strcmp(argv[i], "--incremental-grid")) {
+			g_incremental_grid = true;
+		}
+
+		else if(!strcmp(argv[i], "--lockdown") && has_value) {
+			g_lockdown = strtof(argv[++i], NULL);
+		}
+
+		else if(!strcmp(argv[i], "--crowd-jam") && has_value) {
+			g_crowd_jam_density = strtof(argv[++i], NULL);
+		}
+
+		else if(!strcmp(argv[i], "--tiered")) {
+			g_tiered = true;
+		}
+
+		else if(!strcmp(argv[i], "--sleep-steer") && has_value) {
+			g_sleeping_steer_interval = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if(!strcmp(argv[i], "--run") && has_value) {
+			run_ticks = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if(!strcmp(argv[i], "--bench-reset")) {
+			run_bench_reset = true;
+		}
+
+		else if(!strcmp(argv[i], "--bench-exposure")) {
+			run_bench_exposure = true;
+		}
+
+		else if(!strcmp(argv[i], "--bench-repulsion")) {
+			run_bench_repulsion = true;
+		}
+
+		else if(!strcmp(argv[i], "--bench-kernels")) {
+			run_bench_kernels = true;
+		}
+
+		else if(!strcmp(argv[i], "--bench-fidelity") && has_value) {
+			bench_fidelity_ticks = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if(!strcmp(argv[i], "--bench-steering") && has_value) {
+			bench_steering_ticks = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if(!strcmp(argv[i], "--bench-infection") && has_value) {
+			bench_infection_ticks = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if(!strcmp(argv[i], "--bench-balance") && has_value) {
+			bench_balance_ticks = strtoul(argv[++i], NULL, 10);
+		}
+
+		else if(!strcmp(argv[i], "--bench-grid") && has_value) {
+			bench_grid_frames = strtoul(argv[++i], NULL, 10);
+		}
 
-ushort agents_get_removed(bool* simulated, uint agent_count) {
-	ushort res = 0;
+		else if(!strcmp(argv[i], "--bench-replicas") && has_value) {
+			bench_replicas_ticks = strtoul(argv[++i], NULL, 10);
+		}
 
-	for(ushort i = 0; i < agent_count; i++) {
-		res += (!simulated[i]);
+		else {
+			print_usage();
+			return 1;
+		}
 	}
-	
-	return res;
-}
 
-void agents_reset(Population* population) {
-	for(uint i = 0; i < population->count; i++)
-		population->infected_periods[i] = 0;
+	if(agent_count_option == 0 || world_size_option == 0) {
+		print_usage();
+		return 1;
+	}
 
-	for(uint i = 0; i < population->count; i++)
-		population->simulated[i] = 1;
+	g_world_width = world_size_option;
+	g_world_height = world_size_option;
 
-	rand_vector_array(population->positions, population->count, 0, g_world_width);
-	rand_dir_array(population->directions, population->count);
-}
+	// Start off with a market and a school for agents to crowd into
+	hotspots_add((Vector2) { g_world_width * .3f, g_world_height * .35f });
+	hotspots_add((Vector2) { g_world_width * .7f, g_world_height * .65f });
 
+	chunks_create();
 
-//----------------------------------------------------------------------------------------------------------------------------------
+	Workers* workers = Workers_create(thread_count);
+	Topology* topology = Topology_create();
+
+	if(pin) {
+		Topology_print(topology);
+		if(!Workers_pin(workers, topology->cpus, topology->cpu_count))
+			printf("Pinning workers is not supported here, they are left to the scheduler\n");
+	}
+
+	Population* population = Population_create(agent_count_option);
+
+	if(workers->pinned) {
+		Population_touch(population, workers);
+		Population_print_locality(population, workers, topology);
+	}
 
+	if(run_bench_reset || run_bench_exposure || run_bench_repulsion || run_bench_kernels || run_ticks > 0 || bench_fidelity_ticks > 0 || bench_steering_ticks > 0 || bench_infection_ticks > 0 || bench_balance_ticks > 0 || bench_grid_frames > 0 || bench_replicas_ticks > 0) {
+		if(run_bench_reset)
+			bench_reset(population, workers);
+		else if(run_bench_exposure)
+			bench_exposure(population, workers);
+		else if(run_bench_repulsion)
+			bench_repulsion(population, workers);
+		else if(run_bench_kernels)
+			bench_kernels();
+		else if(bench_fidelity_ticks > 0)
+			bench_fidelity(population, workers, bench_fidelity_ticks);
+		else if(bench_steering_ticks > 0)
+			bench_steering(population, workers, bench_steering_ticks);
+		else if(bench_infection_ticks > 0)
+			bench_infection(population, workers, bench_infection_ticks);
+		else if(bench_balance_ticks > 0)
+			bench_balance(population, workers, bench_balance_ticks);
+		else if(bench_grid_frames > 0)
+			bench_grid(workers, bench_grid_frames);
+		else if(bench_replicas_ticks > 0)
+			bench_replicas(population, workers, bench_replicas_ticks);
+		else
+			run_headless(population, workers, run_ticks);
+
+		Population_print_footprint(population);
+
+		Population_destroy(population);
+		Workers_destroy(workers);
+		Topology_destroy(topology);
+		ParticleMesh_destroy(g_exposure);
+		ParticleMesh_destroy(g_repulsion_mesh);
+		Grid_destroy(g_repulsion_grid);
+		kernel_tables_destroy();
+		crowd_destroy();
+		hotspots_destroy();
+		chunks_destroy();
+		return 0;
+	}
 
-int main() {
 	SetTraceLogLevel(LOG_NONE);
 	SetConfigFlags(FLAG_MSAA_4X_HINT);	
 	InitWindow(1280, 720, "Pandemic");
 
-	Population* population = Population_create(800);
-
 	// Get pointers to all population arrays to simlify code later on
-	Vector2* positions = population->positions;
-	Vector2* directions = population->directions;
+	Tile* tiles = population->tiles;
+	Vector2* offsets = population->offsets;
 	byte* infected_periods = population->infected_periods;
-	byte* time_till_death = population->time_till_death;
-	float* square_distances = population->square_distances;
 	bool* simulated = population->simulated;
-	ushort agent_count = population->count;
+	uint agent_count = population->count;
 
 	Font default_font;
 	default_font = LoadFontEx("Bwana.otf", 30, 0, 0);
 	SetTextureFilter(default_font.texture, TEXTURE_FILTER_BILINEAR);
 
-	g_world_width = 4000;
-	g_world_height = 4000;
-
 	Camera2D camera = { 0 };
-	camera.zoom = .231f;
-	camera.target.x = (g_world_width / 2) - 550.f;
-	camera.target.y = g_world_height / 2;
+	// Start with the whole world in view right of the panel, however large it is
+	camera.zoom = .231f * fminf(1, 4000.f / max(g_world_width, g_world_height));
+	Vector2 target = { (g_world_width / 2) - 550.f * .231f / camera.zoom, g_world_height / 2 };
+	Tile_split(target, &g_view_tile, &camera.target);
 
 	float simulation_speed = 1.f;
 
@@ -391,11 +3005,17 @@ int main() {
 	Graph* removed_graph = Graph_create(400);
 
 	Slider* simulation_speed_slider = Slider_create(15, 80, 300, 3, &simulation_speed, 0.f, 3.f);
-	Slider* social_distance_slider = Slider_create(15, 80, 300, 3, &g_social_distance, 20.f, 120.f);
-	Slider* social_distance_importance_slider = Slider_create(15, 10, 300, 3, &g_social_distance_factor, 0.f, 1.f);
-	Slider* infection_radius_slider = Slider_create(15, 10, 300, 3, &g_infection_radius, 40.f, 100.f);
-	Slider* infection_chance_slider = Slider_create(15, 10, 300, 3, &g_infection_chance, 0.05f, 1.f);
-	Slider* infection_duration_slider = Slider_create(15, 10, 300, 3, &g_infection_duration, 5.f, 30.f);
+
+	// Sliders only ever touch the UI's own copy of the parameters, which is published whenever it changes
+	Parameters ui_parameters = parameters_current();
+	Parameters published_parameters = ui_parameters;
+	g_parameter_buffer = ParameterBuffer_create(&ui_parameters);
+
+	Slider* social_distance_slider = Slider_create(15, 80, 300, 3, &ui_parameters.social_distance, 20.f, 120.f);
+	Slider* social_distance_importance_slider = Slider_create(15, 10, 300, 3, &ui_parameters.social_distance_factor, 0.f, 1.f);
+	Slider* infection_radius_slider = Slider_create(15, 10, 300, 3, &ui_parameters.infection_radius, 40.f, 100.f);
+	Slider* infection_chance_slider = Slider_create(15, 10, 300, 3, &ui_parameters.infection_chance, 0.05f, 1.f);
+	Slider* infection_duration_slider = Slider_create(15, 10, 300, 3, &ui_parameters.infection_duration, 5.f, 30.f);
 
 	float counter = 0;
 	float days = 1;
@@ -408,12 +3028,10 @@ int main() {
 	uint removed;
 
 
-	printf("About to print this message\n");
+	Population_print_footprint(population);
 
-	agents_reset(population);
-	// Randomly infect one member of the population
-	infected_periods[0] = 1;
-	time_till_death[0] = (byte) g_infection_duration;
+	agents_reset(population, workers);
+	agents_seed_infection(population);
 
 	while(!WindowShouldClose()) {
 		float ui_ratio = GetScreenWidth() / 1280.f;
@@ -422,6 +3040,10 @@ int main() {
 		delta = (GetTime() - prev_time);
 		prev_time = GetTime();
 
+		// Deterministic runs step by exactly one frame no matter how long the frame really took
+		if(g_deterministic)
+			delta = FIXED_DELTA;
+
 		counter += delta * simulation_speed;
 		graph_counter += delta * simulation_speed;
 
@@ -448,31 +3070,62 @@ int main() {
 			Slider_update(infection_chance_slider);
 			Slider_update(infection_duration_slider);
 			Slider_update(infection_radius_slider);
+
+			if(memcmp(&ui_parameters, &published_parameters, sizeof(Parameters))) {
+				ParameterBuffer_publish(g_parameter_buffer, &ui_parameters);
+				published_parameters = ui_parameters;
+			}
+		}
+
+		// Restart the epidemic, reusing the population's memory
+		if(IsKeyPressed(KEY_R)) {
+			if(!Population_reset(population, agent_count))
+				printf("%u agents don't fit in the population's memory, restarting with %u\n", agent_count, population->count);
+
+			agents_reset(population, workers);
+			agents_seed_infection(population);
+			g_frame = 0;
+			g_steer_frame = 0;
+			g_tick = 0;
+
+			Graph_clear(total_cases_graph);
+			Graph_clear(active_cases_graph);
+			Graph_clear(removed_graph);
+			days = 1;
 		}
 
+		// Switch between tiered and full fidelity
+		if(IsKeyPressed(KEY_T))
+			g_tiered = !g_tiered;
+
+		// Show how crowded every cell is
+		if(IsKeyPressed(KEY_D))
+			g_crowd_draw = !g_crowd_draw;
+
 		// Handle player input
 		if(((GetMouseX() > 330 * ui_ratio || GetMouseY() > 660 * ui_ratio) && cursor_focus == 0) || cursor_focus == 2) {
 			player_move(&camera, delta);
+
+			// Right clicking in the world places a new hotspot
+			if(IsMouseButtonPressed(MOUSE_RIGHT_BUTTON))
+				hotspots_add(Tile_position(g_view_tile, GetScreenToWorld2D(GetMousePosition(), camera)));
 		}
 
-		// Move the agents every frame
-		agents_find_distances(square_distances, positions, agent_count);
-		agents_steer(directions, positions, simulated, square_distances, agent_count);
-		agents_move(directions, positions, agent_count, delta * simulation_speed);
+		bool tick = counter > .1f;
+		uint substeps = simulation_advance(population, workers, delta * simulation_speed, tick);
 
 		// On game tick
-		if(counter > .1f) {
-			// Spread disease
-			agents_spread_disease(positions, square_distances, infected_periods, simulated, time_till_death, agent_count);
-			agents_age(infected_periods, simulated, time_till_death, agent_count);
+		if(tick) {
 			days += .1f;
 			counter = 0;
 		}
 
 		// Get disease spread information
-		total_cases = agents_get_cases(infected_periods, agent_count);
-		active_cases = agents_get_active_cases(infected_periods, simulated, agent_count);
-		removed = agents_get_removed(simulated, agent_count);
+		Statistics statistics = simulation_count(population, workers);
+		uint live_count = population->live_count;
+		total_cases = statistics.total_cases;
+		active_cases = statistics.active_cases;
+		removed = statistics.removed;
 		
 		if(graph_counter > .2f) {
 			// Update graph values
@@ -499,8 +3152,13 @@ int main() {
 		// Draw scene
 		BeginMode2D(camera);
 
-		agents_draw(positions, infected_periods, simulated, agent_count);
-		DrawRectangleLinesEx((Rectangle) { 0, 0, g_world_width, g_world_height }, 4, WHITE);
+		crowd_draw(crowd_grid(population));
+		chunks_draw();
+		hotspots_draw();
+		agents_draw(tiles, offsets, infected_periods, simulated, live_count, agent_count);
+
+		Vector2 origin = view_position((Vector2) { 0, 0 });
+		DrawRectangleLinesEx((Rectangle) { origin.x, origin.y, g_world_width, g_world_height }, 4, WHITE);
 		EndMode2D();
 
 
@@ -536,7 +3194,7 @@ int main() {
 		sprintf(text, "Disease / Recovered: %i (%.1f%)", removed, ((float)removed / (float)agent_count) * 100.f);
 		DrawTextEx(default_font, text, (Vector2) { 15, 80 + graph_height }, (int)(20.f * ui_ratio), 0, GRAY);
 
-		sprintf(text, "Day: %i", (int) days);
+		sprintf(text, substeps > 1 ? "Day: %i (%u sub-steps)" : "Day: %i", (int) days, substeps);
 		DrawTextEx(default_font, text, (Vector2) { 15, 105 + graph_height }, (int)(20.f * ui_ratio), 0, WHITE);
 
 
@@ -550,27 +3208,27 @@ int main() {
 		simulation_speed_slider->y = (380.f * ui_ratio);
 		Slider_draw(simulation_speed_slider, WHITE, ui_light_grey);
 
-		sprintf(text, "Social Distance (%.2fm)", (g_social_distance / 120) * 1.5f);
+		sprintf(text, "Social Distance (%.2fm)", (ui_parameters.social_distance / 120) * 1.5f);
 		DrawTextEx(default_font, text, (Vector2) { 15, 400 * ui_ratio }, 20 * ui_ratio, 0, WHITE);
 		social_distance_slider->y = (430.f * ui_ratio);
 		Slider_draw(social_distance_slider, WHITE, ui_light_grey);
 
-		sprintf(text, "Social Distance Multipliyer (x%.2f)", g_social_distance_factor);
+		sprintf(text, "Social Distance Multipliyer (x%.2f)", ui_parameters.social_distance_factor);
 		DrawTextEx(default_font, text, (Vector2) { 15, 450 * ui_ratio }, 20 * ui_ratio, 0, WHITE);
 		social_distance_importance_slider->y = (480.f * ui_ratio);
 		Slider_draw(social_distance_importance_slider, WHITE, ui_light_grey);
 
-		sprintf(text, "Infection Chance (%.1f%)", g_infection_chance * 100);
+		sprintf(text, "Infection Chance (%.1f%)", ui_parameters.infection_chance * 100);
 		DrawTextEx(default_font, text, (Vector2) { 15, 500 * ui_ratio }, 20 * ui_ratio, 0, RED);
 		infection_chance_slider->y = (530.f * ui_ratio);
 		Slider_draw(infection_chance_slider, RED, ui_light_grey);
 
-		sprintf(text, "Infection Radius (%.2fm)", (g_infection_radius / 120) * 1.5f);
+		sprintf(text, "Infection Radius (%.2fm)", (ui_parameters.infection_radius / 120) * 1.5f);
 		DrawTextEx(default_font, text, (Vector2) { 15, 550 * ui_ratio }, 20 * ui_ratio, 0, RED);
 		infection_radius_slider->y = (580.f * ui_ratio);
 		Slider_draw(infection_radius_slider, RED, ui_light_grey);
 
-		sprintf(text, "Infection Duration (~%.0f days)", (g_infection_duration));
+		sprintf(text, "Infection Duration (~%.0f days)", (ui_parameters.infection_duration));
 		DrawTextEx(default_font, text, (Vector2) { 15, 600 * ui_ratio }, 20 * ui_ratio, 0, RED);
 		infection_duration_slider->y = (630.f * ui_ratio);
 		Slider_draw(infection_duration_slider, RED, ui_light_grey);
@@ -591,8 +3249,18 @@ int main() {
 	Slider_destroy(social_distance_importance_slider);
 	Slider_destroy(infection_chance_slider);
 	Slider_destroy(infection_duration_slider);
+	ParameterBuffer_destroy(g_parameter_buffer);
 
 	Population_destroy(population);
+	hotspots_destroy();
+	chunks_destroy();
+	Workers_destroy(workers);
+	Topology_destroy(topology);
+	ParticleMesh_destroy(g_exposure);
+	ParticleMesh_destroy(g_repulsion_mesh);
+	Grid_destroy(g_repulsion_grid);
+	kernel_tables_destroy();
+	crowd_destroy();
 
 	return 0;
 }
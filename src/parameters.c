@@ -0,0 +1,47 @@
+#include <stdlib.h>
+
+#include "../include/parameters.h"
+
+#define PARAMETERS_FRESH 4u
+#define PARAMETERS_INDEX 3u
+
+ParameterBuffer* ParameterBuffer_create(const Parameters* initial) {
+	ParameterBuffer* buffer = (ParameterBuffer*) malloc(sizeof(ParameterBuffer));
+
+	for(uint i = 0; i < 3; i++) {
+		buffer->blocks[i] = *initial;
+		buffer->blocks[i].version = 0;
+	}
+
+	buffer->front = 0;
+	atomic_init(&buffer->shared, 1);
+	buffer->back = 2;
+	buffer->version = 0;
+	return buffer;
+}
+
+void ParameterBuffer_destroy(ParameterBuffer* buffer) {
+	free(buffer);
+}
+
+void ParameterBuffer_publish(ParameterBuffer* buffer, const Parameters* parameters) {
+	Parameters* block = &buffer->blocks[buffer->back];
+	*block = *parameters;
+	block->version = ++buffer->version;
+
+	// Release so the block is complete before the latcher can see its index
+	uint previous = atomic_exchange_explicit(&buffer->shared, buffer->back | PARAMETERS_FRESH, memory_order_acq_rel);
+	buffer->back = previous & PARAMETERS_INDEX;
+}
+
+const Parameters* ParameterBuffer_latch(ParameterBuffer* buffer, bool* fresh) {
+	*fresh = false;
+
+	if(atomic_load_explicit(&buffer->shared, memory_order_relaxed) & PARAMETERS_FRESH) {
+		uint previous = atomic_exchange_explicit(&buffer->shared, buffer->front, memory_order_acq_rel);
+		buffer->front = previous & PARAMETERS_INDEX;
+		*fresh = true;
+	}
+
+	return &buffer->blocks[buffer->front];
+}
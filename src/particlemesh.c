@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/particlemesh.h"
+
+// Rows and columns are transformed a few at a time per worker
+#define MESH_LINE_CHUNK 8
+
+typedef struct {
+	ParticleMesh* mesh;
+	float* real;
+	float* imag;
+	bool inverse;
+} ParticleMeshJob;
+
+static void mesh_rows_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	ParticleMeshJob* job = (ParticleMeshJob*) data;
+	uint size = job->mesh->size;
+
+	for(uint row = begin; row < end; row++)
+		Fft_run(job->mesh->fft, job->real + row * size, job->imag + row * size, 1, job->inverse);
+}
+
+static void mesh_columns_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	ParticleMeshJob* job = (ParticleMeshJob*) data;
+	uint size = job->mesh->size;
+
+	for(uint column = begin; column < end; column++)
+		Fft_run(job->mesh->fft, job->real + column, job->imag + column, size, job->inverse);
+}
+
+// Two dimensional transform, every row and then every column. Each line is independent of the others
+static void mesh_transform(ParticleMesh* mesh, Workers* workers, float* real, float* imag, bool inverse) {
+	ParticleMeshJob job = { mesh, real, imag, inverse };
+	Workers_run(workers, mesh_rows_chunk, &job, mesh->size, MESH_LINE_CHUNK);
+	Workers_run(workers, mesh_columns_chunk, &job, mesh->size, MESH_LINE_CHUNK);
+}
+
+// Nodes needed on a side. Padding by the reach on one side is enough, a wrapped contribution would have to come from
+// further than that. Two more nodes on each side leave room for the gradient at the edges
+static uint mesh_measure(float world_width, float world_height, float cell_size, float reach, uint* columns, uint* rows) {
+	*columns = (uint) ceilf(world_width / cell_size) + 4;
+	*rows = (uint) ceilf(world_height / cell_size) + 4;
+	return (*columns > *rows ? *columns : *rows) + (uint) ceilf(reach / cell_size);
+}
+
+ParticleMesh* ParticleMesh_create(float world_width, float world_height, float cell_size, float inner_nodes, float reach, ParticleMeshKernel kernel, float width, uint max_size) {
+	ParticleMesh* mesh = (ParticleMesh*) malloc(sizeof(ParticleMesh));
+	mesh->width = width;
+	mesh->reach = reach;
+
+	uint needed = mesh_measure(world_width, world_height, cell_size, reach, &mesh->columns, &mesh->rows);
+	while(needed > max_size) {
+		cell_size *= 1.25f;
+		needed = mesh_measure(world_width, world_height, cell_size, reach, &mesh->columns, &mesh->rows);
+	}
+
+	uint reach_nodes = (uint) ceilf(reach / cell_size);
+
+	mesh->cell_size = cell_size;
+	mesh->inner = inner_nodes * cell_size;
+	mesh->size = 1;
+	while(mesh->size < needed)
+		mesh->size <<= 1;
+
+	uint count = mesh->size * mesh->size;
+	mesh->fft = Fft_create(mesh->size);
+	mesh->real = (float*) calloc(count, sizeof(float));
+	mesh->imag = (float*) calloc(count, sizeof(float));
+	mesh->kernel_real = (float*) calloc(count, sizeof(float));
+	mesh->kernel_imag = (float*) calloc(count, sizeof(float));
+
+	// The kernel is laid out around node zero, negative offsets wrap around to the far end
+	for(int dy = -(int) reach_nodes; dy <= (int) reach_nodes; dy++) {
+		for(int dx = -(int) reach_nodes; dx <= (int) reach_nodes; dx++) {
+			float distance = sqrtf((float) (dx * dx + dy * dy)) * cell_size;
+			if(distance > reach)
+				continue;
+
+			distance = distance < mesh->inner ? mesh->inner : distance;
+
+			uint column = (uint) (dx + (int) mesh->size) % mesh->size;
+			uint row = (uint) (dy + (int) mesh->size) % mesh->size;
+			mesh->kernel_real[row * mesh->size + column] = kernel(distance, width);
+		}
+	}
+
+	// Transforming the kernel only happens once, so it runs serially here
+	for(uint row = 0; row < mesh->size; row++)
+		Fft_run(mesh->fft, mesh->kernel_real + row * mesh->size, mesh->kernel_imag + row * mesh->size, 1, false);
+	for(uint column = 0; column < mesh->size; column++)
+		Fft_run(mesh->fft, mesh->kernel_real + column, mesh->kernel_imag + column, mesh->size, false);
+
+	float scale = 1.f / count;
+	for(uint i = 0; i < count; i++) {
+		mesh->kernel_real[i] *= scale;
+		mesh->kernel_imag[i] *= scale;
+	}
+
+	return mesh;
+}
+
+void ParticleMesh_destroy(ParticleMesh* mesh) {
+	if(mesh == NULL)
+		return;
+
+	Fft_destroy(mesh->fft);
+	free(mesh->real);
+	free(mesh->imag);
+	free(mesh->kernel_real);
+	free(mesh->kernel_imag);
+	free(mesh);
+}
+
+void ParticleMesh_clear(ParticleMesh* mesh) {
+	memset(mesh->real, 0, sizeof(float) * mesh->size * mesh->size);
+	memset(mesh->imag, 0, sizeof(float) * mesh->size * mesh->size);
+}
+
+void ParticleMesh_splat(ParticleMesh* mesh, Vector2 position, float weight) {
+	float fx, fy;
+	float* density = ParticleMesh_locate(mesh, position, &fx, &fy);
+
+	density[0] += weight * (1 - fx) * (1 - fy);
+	density[1] += weight * fx * (1 - fy);
+	density[mesh->size] += weight * (1 - fx) * fy;
+	density[mesh->size + 1] += weight * fx * fy;
+}
+
+void ParticleMesh_convolve(ParticleMesh* mesh, Workers* workers) {
+	uint count = mesh->size * mesh->size;
+	mesh_transform(mesh, workers, mesh->real, mesh->imag, false);
+
+	for(uint i = 0; i < count; i++) {
+		float r = mesh->real[i] * mesh->kernel_real[i] - mesh->imag[i] * mesh->kernel_imag[i];
+		float m = mesh->real[i] * mesh->kernel_imag[i] + mesh->imag[i] * mesh->kernel_real[i];
+		mesh->real[i] = r;
+		mesh->imag[i] = m;
+	}
+
+	mesh_transform(mesh, workers, mesh->real, mesh->imag, true);
+}
@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include <raylib.h>
+#include <raymath.h>
+
+#include "../include/placement.h"
+#include "../include/rng.h"
+
+#define PLACEMENT_CHUNK 16384
+
+// Poisson disk sampling keeps one sample per cell, with cells small enough that two samples can never share one
+#define POISSON_EMPTY 0xffff
+#define POISSON_ATTEMPTS 4
+#define POISSON_ROW_CHUNK 8
+#define POISSON_OFFSET_SCALE (1.f / 65535.f)
+
+// Keeps the placement streams apart from any other stream seeded from the same chunk index
+#define PLACEMENT_STREAM 0x70000000
+
+const char* placement_names[PLACEMENT_MODE_COUNT] = { "uniform", "clustered", "poisson" };
+
+typedef struct {
+	Placement* placement;
+	Vector2* positions;
+	uint count;
+} PlacementJob;
+
+typedef struct {
+	Placement* placement;
+	Vector2* positions;
+	uint count;
+
+	// Two quantised offsets per cell, the x offset is POISSON_EMPTY when the cell has no sample
+	ushort* samples;
+	uint* row_starts;
+	uint columns;
+	uint rows;
+	float cell_size;
+	float radius;
+
+	// Cells whose column and row are the same modulo 3 never read each other, so each phase can run in parallel
+	uint phase_column;
+	uint phase_row;
+
+	uint sample_count;
+} PoissonJob;
+
+static void place_uniform_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	PlacementJob* job = (PlacementJob*) data;
+	Placement* placement = job->placement;
+
+	Rng rng;
+	Rng_seed(&rng, placement->seed, PLACEMENT_STREAM + chunk);
+
+	float* components = (float*) (job->positions + begin);
+	Rng_fill_uniform(&rng, components, (end - begin) * 2);
+
+	for(uint i = 0; i < end - begin; i++) {
+		components[i * 2] *= placement->width;
+		components[i * 2 + 1] *= placement->height;
+	}
+}
+
+static void place_clustered_chunk(void* data, uint chunk, uint begin, uint end, uint worker) {
+	PlacementJob* job = (PlacementJob*) data;
+	Placement* placement = job->placement;
+
+	Rng rng;
+	Rng_seed(&rng, placement->seed, PLACEMENT_STREAM + chunk);
+
+	float picks[256];
+	float offsets[512];
+
+	for(uint start = begin; start < end; start += 256) {
+		uint block = end - start < 256 ? end - start : 256;
+
+		Rng_fill_uniform(&rng, picks, block);
+		Rng_fill_normal(&rng, offsets, block * 2);
+
+		for(uint i = 0; i < block; i++) {
+			Vector2 center = placement->hotspots[(uint) (picks[i] * placement->hotspot_count) % placement->hotspot_count];
+
+			float x = center.x + offsets[i * 2] * placement->cluster_spread;
+			float y = center.y + offsets[i * 2 + 1] * placement->cluster_spread;
+
+			job->positions[start + i].x = Clamp(x, 0, placement->width);
+			job->positions[start + i].y = Clamp(y, 0, placement->height);
+		}
+	}
+}
+
+static inline Vector2 poisson_sample(PoissonJob* job, uint cell, uint column, uint row) {
+	return (Vector2) {
+		(column + job->samples[cell * 2] * POISSON_OFFSET_SCALE) * job->cell_size,
+		(row + job->samples[cell * 2 + 1] * POISSON_OFFSET_SCALE) * job->cell_size
+	};
+}
+
+// The 5x5 neighbourhood without the centre and the corners (which are always at least a radius away), nearest first
+// so that a dart that lands too close is usually rejected on the first few checks
+static const int poisson_dx[20] = { 1, -1, 0, 0, 1, 1, -1, -1, 2, -2, 0, 0, 2, 2, -2, -2, 1, 1, -1, -1 };
+static const int poisson_dy[20] = { 0, 0, 1, -1, 1, -1, 1, -1, 0, 0, 2, -2, 1, -1, 1, -1, 2, -2, 2, -2 };
+
+// Throw a few darts at every cell of one phase in these rows, keeping the first that is far enough from its neighbours.
+// Distances are measured in cells, where the radius is the diagonal of a cell
+static void poisson_phase_rows(void* data, uint chunk, uint begin, uint end, uint worker) {
+	PoissonJob* job = (PoissonJob*) data;
+	float max_column = job->placement->width / job->cell_size;
+	float max_row = job->placement->height / job->cell_size;
+
+	float near_x[20];
+	float near_y[20];
+
+	for(uint phase_index = begin; phase_index < end; phase_index++) {
+		uint row = job->phase_row + phase_index * 3;
+
+		for(uint column = job->phase_column; column < job->columns; column += 3) {
+			uint cell = row * job->columns + column;
+
+			// Gather the neighbouring samples once, relative to this cell's corner
+			uint near_count = 0;
+			for(uint n = 0; n < 20; n++) {
+				int nc = (int) column + poisson_dx[n];
+				int nr = (int) row + poisson_dy[n];
+				if(nc < 0 || nr < 0 || nc >= (int) job->columns || nr >= (int) job->rows)
+					continue;
+
+				uint neighbour = nr * job->columns + nc;
+				if(job->samples[neighbour * 2] == POISSON_EMPTY)
+					continue;
+
+				near_x[near_count] = poisson_dx[n] + job->samples[neighbour * 2] * POISSON_OFFSET_SCALE;
+				near_y[near_count] = poisson_dy[n] + job->samples[neighbour * 2 + 1] * POISSON_OFFSET_SCALE;
+				near_count++;
+			}
+
+			for(uint attempt = 0; attempt < POISSON_ATTEMPTS; attempt++) {
+				uint bits = rng_hash(job->placement->seed, cell, attempt, 0);
+				ushort sx = bits >> 16;
+				ushort sy = bits & 0xffff;
+				sx -= sx == POISSON_EMPTY;
+
+				float x = sx * POISSON_OFFSET_SCALE;
+				float y = sy * POISSON_OFFSET_SCALE;
+
+				if(column + x >= max_column || row + y >= max_row)
+					continue;
+
+				bool accepted = true;
+				for(uint n = 0; n < near_count; n++) {
+					float ox = near_x[n] - x;
+					float oy = near_y[n] - y;
+					if(ox * ox + oy * oy < 2.f) {
+						accepted = false;
+						break;
+					}
+				}
+
+				if(accepted) {
+					job->samples[cell * 2] = sx;
+					job->samples[cell * 2 + 1] = sy;
+					break;
+				}
+			}
+		}
+	}
+}
+
+static void poisson_clear_rows(void* data, uint chunk, uint begin, uint end, uint worker) {
+	PoissonJob* job = (PoissonJob*) data;
+
+	for(uint cell = begin * job->columns; cell < end * job->columns; cell++)
+		job->samples[cell * 2] = POISSON_EMPTY;
+}
+
+static void poisson_count_rows(void* data, uint chunk, uint begin, uint end, uint worker) {
+	PoissonJob* job = (PoissonJob*) data;
+
+	for(uint row = begin; row < end; row++) {
+		uint count = 0;
+		for(uint column = 0; column < job->columns; column++)
+			count += job->samples[(row * job->columns + column) * 2] != POISSON_EMPTY;
+
+		job->row_starts[row] = count;
+	}
+}
+
+// Spread the agents evenly over the samples: with S samples for N agents, agent a takes sample floor(a * S / N).
+// Samples are in row order, so any subset picked this way still covers the whole world
+static void poisson_assign_rows(void* data, uint chunk, uint begin, uint end, uint worker) {
+	PoissonJob* job = (PoissonJob*) data;
+	unsigned long long samples = job->sample_count;
+	unsigned long long agents = job->count;
+
+	for(uint row = begin; row < end; row++) {
+		unsigned long long index = job->row_starts[row];
+
+		for(uint column = 0; column < job->columns; column++) {
+			uint cell = row * job->columns + column;
+			if(job->samples[cell * 2] == POISSON_EMPTY)
+				continue;
+
+			unsigned long long agent = samples > agents ? (index * agents + samples - 1) / samples : index;
+			if(agent < agents && (samples <= agents || agent * samples / agents == index))
+				job->positions[agent] = poisson_sample(job, cell, column, row);
+
+			index++;
+		}
+	}
+}
+
+// Grid based dart throwing, every cell is visited a fixed number of times so the whole thing stays O(N)
+static void place_poisson(Placement* placement, Workers* workers, Vector2* positions, uint count) {
+	PoissonJob job = { 0 };
+	job.placement = placement;
+	job.positions = positions;
+	job.count = count;
+
+	// With a handful of darts per cell this radius gives roughly 10% more samples than agents
+	job.radius = sqrtf(.55f * placement->width * placement->height / count);
+	job.cell_size = job.radius / 1.41421356f;
+	job.columns = (uint) ceilf(placement->width / job.cell_size);
+	job.rows = (uint) ceilf(placement->height / job.cell_size);
+
+	job.samples = (ushort*) malloc(sizeof(ushort) * 2 * (size_t) job.columns * job.rows);
+	job.row_starts = (uint*) malloc(sizeof(uint) * job.rows);
+
+	Workers_run(workers, poisson_clear_rows, &job, job.rows, POISSON_ROW_CHUNK);
+
+	for(uint phase = 0; phase < 9; phase++) {
+		job.phase_column = phase % 3;
+		job.phase_row = phase / 3;
+
+		uint phase_rows = job.rows > job.phase_row ? (job.rows - job.phase_row + 2) / 3 : 0;
+		Workers_run(workers, poisson_phase_rows, &job, phase_rows, POISSON_ROW_CHUNK);
+	}
+
+	Workers_run(workers, poisson_count_rows, &job, job.rows, POISSON_ROW_CHUNK);
+
+	uint total = 0;
+	for(uint row = 0; row < job.rows; row++) {
+		uint row_count = job.row_starts[row];
+		job.row_starts[row] = total;
+		total += row_count;
+	}
+	job.sample_count = total;
+
+	Workers_run(workers, poisson_assign_rows, &job, job.rows, POISSON_ROW_CHUNK);
+
+	// Should the packing come up short, whoever is left over is placed uniformly
+	if(total < count) {
+		PlacementJob rest = { placement, positions + total, count - total };
+		Workers_run(workers, place_uniform_chunk, &rest, count - total, PLACEMENT_CHUNK);
+	}
+
+	free(job.samples);
+	free(job.row_starts);
+}
+
+void Placement_run(Placement* placement, Workers* workers, Vector2* positions, uint count) {
+	if(count == 0)
+		return;
+
+	PlacementJob job = { placement, positions, count };
+
+	if(placement->mode == PLACEMENT_POISSON) {
+		place_poisson(placement, workers, positions, count);
+	}
+
+	else if(placement->mode == PLACEMENT_CLUSTERED && placement->hotspot_count > 0) {
+		Workers_run(workers, place_clustered_chunk, &job, count, PLACEMENT_CHUNK);
+	}
+
+	else {
+		Workers_run(workers, place_uniform_chunk, &job, count, PLACEMENT_CHUNK);
+	}
+}
@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../include/replicas.h"
+#include "../include/rng.h"
+
+// Each kind of draw has its own index, so the streams of one replica never line up
+enum {
+	REPLICA_STREAM_PLACE_X,
+	REPLICA_STREAM_PLACE_Y,
+	REPLICA_STREAM_ANGLE,
+	REPLICA_STREAM_NOISE_X,
+	REPLICA_STREAM_NOISE_Y,
+	REPLICA_STREAM_INFECTION,
+	REPLICA_STREAM_AGING
+};
+
+ReplicaBatch* ReplicaBatch_create(uint replica_count, uint agent_count, float world_width, float world_height) {
+	ReplicaBatch* batch = (ReplicaBatch*) malloc(sizeof(ReplicaBatch));
+	batch->replica_count = replica_count;
+	batch->block_count = (replica_count + REPLICA_LANES - 1) / REPLICA_LANES;
+	batch->agent_count = agent_count;
+	batch->world_width = world_width;
+	batch->world_height = world_height;
+
+	size_t count = (size_t) batch->block_count * agent_count * REPLICA_LANES;
+	batch->x = (float*) malloc(sizeof(float) * count);
+	batch->y = (float*) malloc(sizeof(float) * count);
+	batch->direction_x = (float*) malloc(sizeof(float) * count);
+	batch->direction_y = (float*) malloc(sizeof(float) * count);
+	batch->repulsion_x = (float*) malloc(sizeof(float) * count);
+	batch->repulsion_y = (float*) malloc(sizeof(float) * count);
+	batch->contacts = (float*) malloc(sizeof(float) * count);
+
+	batch->infected_periods = (byte*) malloc(count);
+	batch->time_till_death = (byte*) malloc(count);
+	batch->simulated = (float*) malloc(sizeof(float) * count);
+
+	batch->seeds = (uint*) malloc(sizeof(uint) * batch->block_count * REPLICA_LANES);
+	batch->spreaders = (uint*) malloc(sizeof(uint) * batch->block_count * agent_count);
+	return batch;
+}
+
+void ReplicaBatch_destroy(ReplicaBatch* batch) {
+	if(batch == NULL)
+		return;
+
+	free(batch->x);
+	free(batch->y);
+	free(batch->direction_x);
+	free(batch->direction_y);
+	free(batch->repulsion_x);
+	free(batch->repulsion_y);
+	free(batch->contacts);
+	free(batch->infected_periods);
+	free(batch->time_till_death);
+	free(batch->simulated);
+	free(batch->seeds);
+	free(batch->spreaders);
+	free(batch);
+}
+
+// Offset of agent i's lanes in a block
+static inline size_t replica_offset(ReplicaBatch* batch, uint block, uint i) {
+	return ((size_t) block * batch->agent_count + i) * REPLICA_LANES;
+}
+
+void ReplicaBatch_reset(ReplicaBatch* batch, const Parameters* parameters, uint seed) {
+	size_t count = (size_t) batch->block_count * batch->agent_count * REPLICA_LANES;
+
+	for(uint r = 0; r < batch->block_count * REPLICA_LANES; r++)
+		batch->seeds[r] = seed + r;
+
+	for(uint block = 0; block < batch->block_count; block++) {
+		uint* seeds = batch->seeds + block * REPLICA_LANES;
+
+		for(uint i = 0; i < batch->agent_count; i++) {
+			size_t offset = replica_offset(batch, block, i);
+
+			for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+				float angle = rng_uniform(seeds[lane], i, 0, REPLICA_STREAM_ANGLE) * 2 * PI;
+
+				batch->x[offset + lane] = rng_uniform(seeds[lane], i, 0, REPLICA_STREAM_PLACE_X) * batch->world_width;
+				batch->y[offset + lane] = rng_uniform(seeds[lane], i, 0, REPLICA_STREAM_PLACE_Y) * batch->world_height;
+				batch->direction_x[offset + lane] = cosf(angle);
+				batch->direction_y[offset + lane] = sinf(angle);
+			}
+		}
+
+		// The first agent of every replica starts out infected, a batch without agents has nobody to infect
+		if(batch->agent_count == 0)
+			continue;
+
+		memset(batch->infected_periods + replica_offset(batch, block, 0), 1, REPLICA_LANES);
+		memset(batch->infected_periods + replica_offset(batch, block, 1), 0, (size_t) (batch->agent_count - 1) * REPLICA_LANES);
+	}
+
+	memset(batch->time_till_death, (byte) parameters->infection_duration, count);
+	for(size_t i = 0; i < count; i++)
+		batch->simulated[i] = 1;
+}
+
+// Same rule as the full simulation: push away from everyone within the social distance, weighted by one over the
+// square distance. Each pair is visited once and pushes both agents apart. Lanes with nobody close enough still
+// compute, they just add nothing. Most pairs are out of reach in every lane though, those only get their distances
+// checked and leave the divisions and agent j's sums alone
+static inline void replicas_repel_lanes(float* restrict xi, float* restrict yi, float* restrict simulated_i, float* restrict repulsion_xi, float* restrict repulsion_yi, float* restrict xj, float* restrict yj, float* restrict simulated_j, float* restrict repulsion_xj, float* restrict repulsion_yj, float social_distance_sqr) {
+	int reached = 0;
+	for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+		float dx = xi[lane] - xj[lane];
+		float dy = yi[lane] - yj[lane];
+		reached |= dx * dx + dy * dy <= social_distance_sqr;
+	}
+
+	if(!reached)
+		return;
+
+	for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+		float dx = xi[lane] - xj[lane];
+		float dy = yi[lane] - yj[lane];
+		float dist = dx * dx + dy * dy;
+
+		// Agents right on top of each other don't push, the conditions are combined without branching
+		float near = (float) ((dist <= social_distance_sqr) & (dist > 0));
+		float weight = near / (dist + (1 - near));
+
+		repulsion_xi[lane] += dx * weight * simulated_j[lane];
+		repulsion_yi[lane] += dy * weight * simulated_j[lane];
+		repulsion_xj[lane] -= dx * weight * simulated_i[lane];
+		repulsion_yj[lane] -= dy * weight * simulated_i[lane];
+	}
+}
+
+static void replicas_repulse(ReplicaBatch* batch, float social_distance, uint block) {
+	float social_distance_sqr = social_distance * social_distance;
+	size_t offset = replica_offset(batch, block, 0);
+	float* x = batch->x + offset;
+	float* y = batch->y + offset;
+	float* simulated = batch->simulated + offset;
+	float* repulsion_x = batch->repulsion_x + offset;
+	float* repulsion_y = batch->repulsion_y + offset;
+
+	memset(repulsion_x, 0, sizeof(float) * batch->agent_count * REPLICA_LANES);
+	memset(repulsion_y, 0, sizeof(float) * batch->agent_count * REPLICA_LANES);
+
+	for(uint i = 0; i < batch->agent_count; i++) {
+		float xi[REPLICA_LANES], yi[REPLICA_LANES], simulated_i[REPLICA_LANES];
+		float repulsion_xi[REPLICA_LANES] = { 0 }, repulsion_yi[REPLICA_LANES] = { 0 };
+
+		memcpy(xi, x + i * REPLICA_LANES, sizeof(xi));
+		memcpy(yi, y + i * REPLICA_LANES, sizeof(yi));
+		memcpy(simulated_i, simulated + i * REPLICA_LANES, sizeof(simulated_i));
+
+		for(uint j = i + 1; j < batch->agent_count; j++) {
+			uint k = j * REPLICA_LANES;
+			replicas_repel_lanes(xi, yi, simulated_i, repulsion_xi, repulsion_yi, x + k, y + k, simulated + k, repulsion_x + k, repulsion_y + k, social_distance_sqr);
+		}
+
+		for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+			repulsion_x[i * REPLICA_LANES + lane] += repulsion_xi[lane];
+			repulsion_y[i * REPLICA_LANES + lane] += repulsion_yi[lane];
+		}
+	}
+}
+
+static void replicas_steer(ReplicaBatch* batch, float social_distance_factor, uint frame, uint block) {
+	uint* seeds = batch->seeds + block * REPLICA_LANES;
+	float right = batch->world_width - 10;
+	float bottom = batch->world_height - 10;
+
+	for(uint i = 0; i < batch->agent_count; i++) {
+		size_t offset = replica_offset(batch, block, i);
+		float* x = batch->x + offset;
+		float* y = batch->y + offset;
+		float* direction_x = batch->direction_x + offset;
+		float* direction_y = batch->direction_y + offset;
+		float* repulsion_x = batch->repulsion_x + offset;
+		float* repulsion_y = batch->repulsion_y + offset;
+
+		for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+			float noise_x = rng_uniform(seeds[lane], i, frame, REPLICA_STREAM_NOISE_X);
+			float noise_y = rng_uniform(seeds[lane], i, frame, REPLICA_STREAM_NOISE_Y);
+
+			float dx = direction_x[lane] + repulsion_x[lane] * social_distance_factor + ((noise_x * 2) - 1.f) / 100.f;
+			float dy = direction_y[lane] + repulsion_y[lane] * social_distance_factor + ((noise_y * 2) - 1.f) / 100.f;
+
+			// Clamp the directions as to not result in infinite acceleration
+			dx = dx < -1 ? -1 : (dx > 1 ? 1 : dx);
+			dy = dy < -1 ? -1 : (dy > 1 ? 1 : dy);
+
+			// Bounce off walls
+			dx = (x[lane] < 10 && dx < 0) || (x[lane] > right && dx > 0) ? -dx : dx;
+			dy = (y[lane] < 10 && dy < 0) || (y[lane] > bottom && dy > 0) ? -dy : dy;
+
+			direction_x[lane] = dx;
+			direction_y[lane] = dy;
+		}
+	}
+}
+
+static void replicas_move(ReplicaBatch* batch, float delta, uint block) {
+	for(uint i = 0; i < batch->agent_count; i++) {
+		size_t offset = replica_offset(batch, block, i);
+		float* x = batch->x + offset;
+		float* y = batch->y + offset;
+		float* direction_x = batch->direction_x + offset;
+		float* direction_y = batch->direction_y + offset;
+
+		for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+			x[lane] += direction_x[lane] * delta * 90.f;
+			y[lane] += direction_y[lane] * delta * 90.f;
+		}
+	}
+}
+
+// Every susceptible agent counts its infectious neighbours, then makes a single draw against the chance of catching it
+// from any of them, like the aggregated kernel of the full simulation. Only agents infectious in some lane are counted
+// against, for most of an epidemic that is a small part of the block. Aging follows straight after
+static void replicas_spread(ReplicaBatch* batch, const Parameters* parameters, uint tick, uint block) {
+	uint* seeds = batch->seeds + block * REPLICA_LANES;
+	float infection_radius_sqr = parameters->infection_radius * parameters->infection_radius;
+	float log_escape = parameters->infection_chance < 1 ? logf(1 - parameters->infection_chance) : -INFINITY;
+	byte duration = (byte) parameters->infection_duration;
+
+	float* x = batch->x + replica_offset(batch, block, 0);
+	float* y = batch->y + replica_offset(batch, block, 0);
+	byte* periods = batch->infected_periods + replica_offset(batch, block, 0);
+	float* simulated = batch->simulated + replica_offset(batch, block, 0);
+	byte* time_till_death = batch->time_till_death + replica_offset(batch, block, 0);
+
+	// Agents must wait a tick before they can spread the disease, infectious ones are marked per lane up front
+	float* infectious = batch->contacts + replica_offset(batch, block, 0);
+	for(uint i = 0; i < batch->agent_count * REPLICA_LANES; i++) {
+		periods[i] += periods[i] == 1;
+		infectious[i] = (float) (periods[i] >= 2) * simulated[i];
+	}
+
+	uint* spreaders = batch->spreaders + (size_t) block * batch->agent_count;
+	uint spreader_count = 0;
+
+	for(uint i = 0; i < batch->agent_count; i++) {
+		float lanes = 0;
+		for(uint lane = 0; lane < REPLICA_LANES; lane++)
+			lanes += infectious[i * REPLICA_LANES + lane];
+
+		if(lanes > 0)
+			spreaders[spreader_count++] = i;
+	}
+
+	for(uint j = 0; j < batch->agent_count; j++) {
+		float xj[REPLICA_LANES], yj[REPLICA_LANES];
+		float contacts[REPLICA_LANES] = { 0 };
+
+		memcpy(xj, x + j * REPLICA_LANES, sizeof(xj));
+		memcpy(yj, y + j * REPLICA_LANES, sizeof(yj));
+
+		for(uint s = 0; s < spreader_count; s++) {
+			uint i = spreaders[s];
+			float* xi = x + i * REPLICA_LANES;
+			float* yi = y + i * REPLICA_LANES;
+			float* infectious_i = infectious + i * REPLICA_LANES;
+
+			for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+				float dx = xi[lane] - xj[lane];
+				float dy = yi[lane] - yj[lane];
+				contacts[lane] += (float) (dx * dx + dy * dy < infection_radius_sqr) * infectious_i[lane];
+			}
+		}
+
+		for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+			uint k = j * REPLICA_LANES + lane;
+			if(periods[k] != 0 || !simulated[k] || contacts[lane] == 0)
+				continue;
+
+			if(rng_uniform(seeds[lane], j, tick, REPLICA_STREAM_INFECTION) < 1 - expf(contacts[lane] * log_escape)) {
+				periods[k] = 1;
+				time_till_death[k] = duration;
+			}
+		}
+	}
+
+	for(uint i = 0; i < batch->agent_count; i++) {
+		for(uint lane = 0; lane < REPLICA_LANES; lane++) {
+			uint k = i * REPLICA_LANES + lane;
+			bool aging = periods[k] > 0 && periods[k] < parameters->infection_duration;
+
+			periods[k] += aging && rng_uniform(seeds[lane], i, tick, REPLICA_STREAM_AGING) < .1f;
+			simulated[k] *= (float) (periods[k] < time_till_death[k]);
+		}
+	}
+}
+
+void ReplicaBatch_step(ReplicaBatch* batch, const Parameters* parameters, float delta, uint frame, uint tick, bool game_tick, uint begin, uint end) {
+	for(uint block = begin; block < end; block++) {
+		replicas_repulse(batch, parameters->social_distance, block);
+		replicas_steer(batch, parameters->social_distance_factor, frame, block);
+
+		if(game_tick)
+			replicas_spread(batch, parameters, tick, block);
+
+		replicas_move(batch, delta, block);
+	}
+}
+
+void ReplicaBatch_count(ReplicaBatch* batch, uint replica, uint* total_cases, uint* active_cases) {
+	uint block = replica / REPLICA_LANES;
+	uint lane = replica % REPLICA_LANES;
+	*total_cases = 0;
+	*active_cases = 0;
+
+	for(uint i = 0; i < batch->agent_count; i++) {
+		size_t k = replica_offset(batch, block, i) + lane;
+		*total_cases += batch->infected_periods[k] > 0 || !batch->simulated[k];
+		*active_cases += batch->infected_periods[k] > 0 && batch->simulated[k];
+	}
+}
@@ -0,0 +1,151 @@
+#include <math.h>
+
+#include "../include/rng.h"
+
+#define PI_F 3.14159265f
+
+// Work is done in blocks that fit comfortably on the stack
+#define RNG_BLOCK 256
+
+static inline uint rotl(uint x, int k) {
+	return (x << k) | (x >> (32 - k));
+}
+
+// Seed every lane through splitmix so nearby seeds and streams still give unrelated sequences
+void Rng_seed(Rng* rng, uint seed, uint stream) {
+	unsigned long long x = ((unsigned long long) stream << 32) ^ seed;
+
+	for(uint lane = 0; lane < RNG_LANES; lane++) {
+		for(uint word = 0; word < 4; word++) {
+			x += 0x9e3779b97f4a7c15ull;
+			unsigned long long z = x;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			z ^= z >> 31;
+
+			// xoshiro must never have an all zero state
+			rng->s[word][lane] = (uint) z | (word == 0);
+		}
+	}
+}
+
+// Step every lane once, writing one value per lane
+static inline void Rng_next(Rng* rng, uint* out) {
+	uint* s0 = rng->s[0];
+	uint* s1 = rng->s[1];
+	uint* s2 = rng->s[2];
+	uint* s3 = rng->s[3];
+
+	for(uint lane = 0; lane < RNG_LANES; lane++) {
+		out[lane] = s0[lane] + s3[lane];
+
+		uint t = s1[lane] << 9;
+		s2[lane] ^= s0[lane];
+		s3[lane] ^= s1[lane];
+		s1[lane] ^= s2[lane];
+		s0[lane] ^= s3[lane];
+		s2[lane] ^= t;
+		s3[lane] = rotl(s3[lane], 11);
+	}
+}
+
+void Rng_fill_uniform(Rng* rng, float* out, uint count) {
+	uint bits[RNG_LANES];
+	uint i = 0;
+
+	for(; i + RNG_LANES <= count; i += RNG_LANES) {
+		Rng_next(rng, bits);
+		for(uint lane = 0; lane < RNG_LANES; lane++)
+			out[i + lane] = (bits[lane] >> 8) * (1.f / 16777216.f);
+	}
+
+	if(i < count) {
+		Rng_next(rng, bits);
+		for(uint lane = 0; i < count; lane++, i++)
+			out[i] = (bits[lane] >> 8) * (1.f / 16777216.f);
+	}
+}
+
+// Box-Muller, each pair of uniforms becomes a pair of normals
+void Rng_fill_normal(Rng* rng, float* out, uint count) {
+	float u[RNG_BLOCK];
+	float radii[RNG_BLOCK / 2];
+	float angles[RNG_BLOCK / 2];
+	float sines[RNG_BLOCK / 2];
+	float cosines[RNG_BLOCK / 2];
+
+	for(uint start = 0; start < count; start += RNG_BLOCK) {
+		uint block = count - start < RNG_BLOCK ? count - start : RNG_BLOCK;
+		uint pairs = (block + 1) / 2;
+
+		Rng_fill_uniform(rng, u, pairs * 2);
+
+		for(uint i = 0; i < pairs; i++) {
+			radii[i] = sqrtf(-2.f * logf(1.f - u[i]));
+			angles[i] = u[pairs + i] * 2.f * PI_F;
+		}
+
+		sincos_array(angles, sines, cosines, pairs);
+
+		for(uint i = 0; i < pairs; i++) {
+			out[start + i * 2] = radii[i] * cosines[i];
+			if(i * 2 + 1 < block)
+				out[start + i * 2 + 1] = radii[i] * sines[i];
+		}
+	}
+}
+
+static inline void hashed_uniform_lanes(float* restrict out, uint h0, uint* restrict keys, uint counter, uint lanes) {
+	for(uint lane = 0; lane < lanes; lane++) {
+		uint h = rng_mix(h0 ^ keys[lane]);
+		h = rng_mix(h ^ counter);
+		h = rng_mix(h);
+		out[lane] = (h >> 8) * (1.f / 16777216.f);
+	}
+}
+
+void rng_fill_hashed_uniform(float* out, uint seed, uint* keys, uint counter, uint count) {
+	uint h0 = rng_mix(seed ^ 0x9e3779b9);
+	uint i = 0;
+
+	for(; i + RNG_LANES <= count; i += RNG_LANES)
+		hashed_uniform_lanes(out + i, h0, keys + i, counter, RNG_LANES);
+
+	hashed_uniform_lanes(out + i, h0, keys + i, counter, count - i);
+}
+
+// Reduce to [-pi/4, pi/4] around the nearest quarter turn, evaluate both minimax polynomials (cephes coefficients)
+// and pick the right pair for the quadrant without branching
+static inline void sincos_lanes(float* restrict angles, float* restrict sines, float* restrict cosines, uint lanes) {
+	for(uint lane = 0; lane < lanes; lane++) {
+		float x = angles[lane];
+		int quadrant = (int) (x * (2.f / PI_F) + copysignf(.5f, x));
+		float q = (float) quadrant;
+
+		// Two part Cody-Waite reduction keeps the error small for angles up to a few turns
+		float y = x - q * 1.5703125f;
+		y = y - q * 4.83751296997e-4f;
+		float z = y * y;
+
+		float s = y + y * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+		float c = 1.f - .5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+
+		float swap = (float) (quadrant & 1);
+		float sine = s + swap * (c - s);
+		float cosine = c + swap * (-s - c);
+
+		float flip = 1.f - (float) (quadrant & 2);
+		sines[lane] = sine * flip;
+		cosines[lane] = cosine * flip;
+	}
+}
+
+// Full blocks have a fixed lane count so they are vectorised, the remainder is done lane by lane
+void sincos_array(float* angles, float* sines, float* cosines, uint count) {
+	uint i = 0;
+
+	for(; i + RNG_LANES <= count; i += RNG_LANES)
+		sincos_lanes(angles + i, sines + i, cosines + i, RNG_LANES);
+
+	sincos_lanes(angles + i, sines + i, cosines + i, count - i);
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../include/topology.h"
+#include "../include/workers.h"
+
+#define MAX_NODES 64
+
+// Flags for get_mempolicy, called through syscall so there is no need to link libnuma
+#define MPOL_F_NODE (1 << 0)
+#define MPOL_F_ADDR (1 << 1)
+
+// Read a list like "0-3,8-11" into cpus, returning how many were added
+static uint parse_cpu_list(const char* list, uint* cpus, uint capacity) {
+	uint count = 0;
+	const char* c = list;
+
+	while(*c != '\0' && *c != '\n') {
+		char* next;
+		ulong first = strtoul(c, &next, 10);
+		ulong last = first;
+
+		if(next == c)
+			break;
+
+		if(*next == '-')
+			last = strtoul(next + 1, &next, 10);
+
+		for(ulong cpu = first; cpu <= last && count < capacity; cpu++)
+			cpus[count++] = (uint) cpu;
+
+		c = *next == ',' ? next + 1 : next;
+	}
+
+	return count;
+}
+
+static bool read_line(const char* path, char* line, size_t size) {
+	FILE* file = fopen(path, "r");
+	if(file == NULL)
+		return false;
+
+	bool read = fgets(line, size, file) != NULL;
+	fclose(file);
+	return read;
+}
+
+Topology* Topology_create() {
+	Topology* topology = (Topology*) malloc(sizeof(Topology));
+	uint capacity = cpu_count();
+
+	topology->node_count = 0;
+	topology->node_ids = (uint*) calloc(MAX_NODES, sizeof(uint));
+	topology->node_memory = (ulong*) calloc(MAX_NODES, sizeof(ulong));
+	topology->cpu_count = 0;
+	topology->cpus = (uint*) malloc(sizeof(uint) * capacity);
+	topology->cpu_nodes = (uint*) malloc(sizeof(uint) * capacity);
+
+#if defined(__linux__)
+	char line[4096];
+
+	for(uint node = 0; node < MAX_NODES && topology->cpu_count < capacity; node++) {
+		char path[128];
+		sprintf(path, "/sys/devices/system/node/node%u/cpulist", node);
+
+		if(!read_line(path, line, sizeof(line)))
+			continue;
+
+		uint added = parse_cpu_list(line, topology->cpus + topology->cpu_count, capacity - topology->cpu_count);
+		for(uint i = 0; i < added; i++)
+			topology->cpu_nodes[topology->cpu_count + i] = node;
+		topology->cpu_count += added;
+
+		// The second line of meminfo is "Node N MemTotal: <kB> kB"
+		sprintf(path, "/sys/devices/system/node/node%u/meminfo", node);
+		FILE* file = fopen(path, "r");
+		if(file != NULL) {
+			while(fgets(line, sizeof(line), file) != NULL) {
+				char* total = strstr(line, "MemTotal:");
+				if(total != NULL)
+					topology->node_memory[topology->node_count] = strtoul(total + 9, NULL, 10) * 1024;
+			}
+			fclose(file);
+		}
+
+		topology->node_ids[topology->node_count++] = node;
+	}
+#endif
+
+	if(topology->cpu_count == 0) {
+		topology->node_count = 1;
+		topology->node_ids[0] = 0;
+		topology->cpu_count = capacity;
+		for(uint i = 0; i < capacity; i++) {
+			topology->cpus[i] = i;
+			topology->cpu_nodes[i] = 0;
+		}
+	}
+
+	return topology;
+}
+
+void Topology_destroy(Topology* topology) {
+	if(topology == NULL)
+		return;
+
+	free(topology->node_ids);
+	free(topology->node_memory);
+	free(topology->cpus);
+	free(topology->cpu_nodes);
+	free(topology);
+}
+
+void Topology_print(Topology* topology) {
+	printf("Topology: %u nodes, %u cores\n", topology->node_count, topology->cpu_count);
+
+	for(uint node = 0; node < topology->node_count; node++) {
+		uint cores = 0;
+		for(uint i = 0; i < topology->cpu_count; i++)
+			cores += topology->cpu_nodes[i] == topology->node_ids[node];
+
+		printf("    node %u: %u cores, %.1f GB\n", topology->node_ids[node], cores, topology->node_memory[node] / 1073741824.);
+	}
+}
+
+uint Topology_node_of(Topology* topology, uint index) {
+	return topology->cpu_nodes[index % topology->cpu_count];
+}
+
+int Topology_page_node(void* address) {
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+	int node = -1;
+	if(syscall(SYS_get_mempolicy, &node, NULL, 0, address, MPOL_F_NODE | MPOL_F_ADDR) == 0)
+		return node;
+#endif
+
+	return -1;
+}
@@ -0,0 +1,241 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/workers.h"
+
+typedef struct {
+	Workers* workers;
+	uint index;
+} WorkerStart;
+
+uint cpu_count() {
+#if defined(_WIN32)
+	return pthread_num_processors_np();
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint) count : 1;
+#endif
+}
+
+double time_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Pull chunks until there are none left, or when pinned run this worker's share of them out of worker_count
+static void Workers_work(Workers* workers, uint worker, uint worker_count) {
+	double start = time_now();
+
+	uint block_begin = (uint) ((unsigned long long) workers->chunk_count * worker / worker_count);
+	uint block_end = (uint) ((unsigned long long) workers->chunk_count * (worker + 1) / worker_count);
+
+	while(1) {
+		uint chunk;
+		if(workers->pinned) {
+			if(block_begin >= block_end)
+				break;
+			chunk = block_begin++;
+		}
+
+		else {
+			chunk = atomic_fetch_add(&workers->next_chunk, 1);
+			if(chunk >= workers->chunk_count)
+				break;
+		}
+
+		uint begin, end;
+		if(workers->bounds != NULL) {
+			begin = workers->bounds[chunk];
+			end = workers->bounds[chunk + 1];
+		}
+
+		else {
+			begin = chunk * workers->chunk_size;
+			end = begin + workers->chunk_size;
+			if(end > workers->item_count || end < begin)
+				end = workers->item_count;
+		}
+
+		workers->task(workers->data, chunk, begin, end, worker);
+	}
+
+	workers->busy_time[worker] += time_now() - start;
+}
+
+static void* Workers_loop(void* argument) {
+	WorkerStart* start = (WorkerStart*) argument;
+	Workers* workers = start->workers;
+	uint index = start->index;
+	free(start);
+
+	uint generation = 0;
+
+	pthread_mutex_lock(&workers->lock);
+	while(1) {
+		while(!workers->quit && workers->generation == generation)
+			pthread_cond_wait(&workers->start, &workers->lock);
+
+		if(workers->quit)
+			break;
+
+		generation = workers->generation;
+		pthread_mutex_unlock(&workers->lock);
+
+		Workers_work(workers, index, workers->count);
+
+		pthread_mutex_lock(&workers->lock);
+		if(--workers->busy == 0)
+			pthread_cond_signal(&workers->done);
+	}
+	pthread_mutex_unlock(&workers->lock);
+
+	return NULL;
+}
+
+Workers* Workers_create(uint thread_count) {
+	Workers* workers = (Workers*) malloc(sizeof(Workers));
+	workers->count = thread_count > 0 ? thread_count : cpu_count();
+	workers->threads = (pthread_t*) malloc(sizeof(pthread_t) * workers->count);
+	workers->busy_time = (double*) calloc(workers->count, sizeof(double));
+	workers->bounds = NULL;
+	workers->pinned = false;
+
+	pthread_mutex_init(&workers->lock, NULL);
+	pthread_cond_init(&workers->start, NULL);
+	pthread_cond_init(&workers->done, NULL);
+
+	workers->generation = 0;
+	workers->busy = 0;
+	workers->quit = false;
+	atomic_init(&workers->next_chunk, 0);
+
+	for(uint i = 1; i < workers->count; i++) {
+		WorkerStart* start = (WorkerStart*) malloc(sizeof(WorkerStart));
+		start->workers = workers;
+		start->index = i;
+		pthread_create(&workers->threads[i], NULL, Workers_loop, start);
+	}
+
+	return workers;
+}
+
+void Workers_destroy(Workers* workers) {
+	if(workers == NULL)
+		return;
+
+	pthread_mutex_lock(&workers->lock);
+	workers->quit = true;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	for(uint i = 1; i < workers->count; i++)
+		pthread_join(workers->threads[i], NULL);
+
+	pthread_mutex_destroy(&workers->lock);
+	pthread_cond_destroy(&workers->start);
+	pthread_cond_destroy(&workers->done);
+
+	free(workers->threads);
+	free(workers->busy_time);
+	free(workers);
+}
+
+// Hand the chunks out and block until every one has been run
+static void Workers_dispatch(Workers* workers, WorkerTask task, void* data, uint item_count, uint chunk_size, uint* bounds, uint chunk_count) {
+	// Not worth waking anyone up for a single chunk
+	if(workers->count == 1 || chunk_count == 1) {
+		workers->task = task;
+		workers->data = data;
+		workers->item_count = item_count;
+		workers->chunk_size = chunk_size;
+		workers->bounds = bounds;
+		workers->chunk_count = chunk_count;
+		atomic_store(&workers->next_chunk, 0);
+
+		Workers_work(workers, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&workers->lock);
+	workers->task = task;
+	workers->data = data;
+	workers->item_count = item_count;
+	workers->chunk_size = chunk_size;
+	workers->bounds = bounds;
+	workers->chunk_count = chunk_count;
+	atomic_store(&workers->next_chunk, 0);
+	workers->busy = workers->count - 1;
+	workers->generation++;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	Workers_work(workers, 0, workers->count);
+
+	pthread_mutex_lock(&workers->lock);
+	while(workers->busy > 0)
+		pthread_cond_wait(&workers->done, &workers->lock);
+	pthread_mutex_unlock(&workers->lock);
+}
+
+// Split the items into chunks of a fixed size
+void Workers_run(Workers* workers, WorkerTask task, void* data, uint item_count, uint chunk_size) {
+	if(item_count == 0)
+		return;
+
+	chunk_size = chunk_size > 0 ? chunk_size : 1;
+	uint chunk_count = (uint) (((unsigned long long) item_count + chunk_size - 1) / chunk_size);
+
+	Workers_dispatch(workers, task, data, item_count, chunk_size, NULL, chunk_count);
+}
+
+// Run ranges the caller has already split, bounds holds range_count + 1 boundaries
+void Workers_run_ranges(Workers* workers, WorkerTask task, void* data, uint* bounds, uint range_count) {
+	if(range_count == 0 || bounds[range_count] == bounds[0])
+		return;
+
+	Workers_dispatch(workers, task, data, bounds[range_count], 0, bounds, range_count);
+}
+
+// The calling thread is worker 0, so it gets pinned too
+bool Workers_pin(Workers* workers, uint* cpus, uint cpu_count) {
+#if defined(__linux__)
+	bool pinned = cpu_count > 0;
+
+	for(uint i = 0; i < workers->count && pinned; i++) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[i % cpu_count], &set);
+
+		pthread_t thread = i == 0 ? pthread_self() : workers->threads[i];
+		pinned = pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+	}
+
+	workers->pinned = pinned;
+	return pinned;
+#else
+	return false;
+#endif
+}
+
+void Workers_reset_busy(Workers* workers) {
+	for(uint i = 0; i < workers->count; i++)
+		workers->busy_time[i] = 0;
+}
+
+double reduce_pairwise(double* values, uint count, uint stride) {
+	if(count == 0)
+		return 0;
+
+	if(count == 1)
+		return values[0];
+
+	uint half = count / 2;
+	return reduce_pairwise(values, half, stride) + reduce_pairwise(values + half * stride, count - half, stride);
+}